@@ -37,29 +37,67 @@ register map gives register addresses as *word* rather than byte offsets. The
 address map for the 8 bit bus gives byte offsets.
 */
 
+/*
+Every register access goes through the read and write macros below, so a build
+can supply its own versions by defining them before this file is included, for
+example to run the driver against a software model of the chip (see
+test/enc624j600_sim.h). Such a model can't simply be memory. The registers are
+at base + 0x7e00 to 0x7eff, and some of them change by themselves or have side
+effects; writes to the set-bit and clear-bit aliases at 0x100 and 0x180 above a
+register act on the register itself. Buffer memory (0x0000 to 0x5fff) is
+accessed directly, relative to the base address, so that part of the model does
+have to be plain memory at the base address.
+*/
+
+/*
+With ENC624J600_REGTRACE defined, 16-bit register accesses go through functions
+that the driver supplies, so that it can log them.
+*/
+#if defined(ENC624J600_REGTRACE) && !defined(ENC624J600_READ_REG)
+extern unsigned short enc624j600_trace_read();
+extern void enc624j600_trace_write();
+
+#define ENC624J600_WRITE_REG(base, reg_offset, value) \
+	enc624j600_trace_write((base), (reg_offset), (value))
+#define ENC624J600_READ_REG(base, reg_offset) \
+	enc624j600_trace_read((base), (reg_offset))
+#endif
+
 /* Create a word pointer from a register */
+#ifndef ENC624J600_REG
 #define ENC624J600_REG(base, reg_offset) \
 	((volatile unsigned short *)((base) + (reg_offset)))
+#endif
 
 /* Create a byte pointer from a register */
+#ifndef ENC624J600_REG8
 #define ENC624J600_REG8(base, reg_offset) \
 	((volatile unsigned char *)((base) + (reg_offset)))
+#endif
 
 /* Write a 16-bit value to a register*/
+#ifndef ENC624J600_WRITE_REG
 #define ENC624J600_WRITE_REG(base, reg_offset, value) \
 	(*ENC624J600_REG((base), (reg_offset)) = (value))
+#endif
 
 /* Read a 16-bit value from a register */
+#ifndef ENC624J600_READ_REG
 #define ENC624J600_READ_REG(base, reg_offset) \
 	(*ENC624J600_REG((base), (reg_offset)))
+#endif
 
 /* Write an 8-bit value to a register */
+#ifndef ENC624J600_WRITE_REG8
 #define ENC624J600_WRITE_REG8(base, reg_offset, value) \
 	(*ENC624J600_REG8((base), (reg_offset)) = (value))
+#endif
 
 /* Read an 8-bit value from a register */
+#ifndef ENC624J600_READ_REG8
 #define ENC624J600_READ_REG8(base, reg_offset) \
 	(*ENC624J600_REG8((base), (reg_offset)))
+#endif
 
 /*
 The ENC624J600 has special registers that allow individual bits of certain
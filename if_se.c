@@ -46,21 +46,136 @@
 #define VERSION "<unknown>"
 #endif
 
+/* The 68k is big-endian, so values going into frames need no swapping. The
+ * host test harness (see test/) runs the driver on little-endian machines,
+ * where they do. */
+#ifndef htons
+#define htons(x) (x)
+#endif
+
+/* The address p points to, as a number. The test harness has its own, since
+ * long is narrower than a pointer there. */
+#ifndef SE_ADDR
+#define SE_ADDR(p) ((unsigned long)(caddr_t)(p))
+#endif
+
+/* True if p is at an odd address */
+#define SE_ODDADDR(p) (SE_ADDR(p) & 1)
+
 /* Maximum number of supported cards. 030 PDS only has interrupt lines for three
  * slots (9, A and B), so no point in supporting more than 3 */
 #define N_SE 3
 
+/* The context whose interface a card's traffic belongs to: the master of its
+ * bond, if it is in one, otherwise its own */
+#define SE_IFCTX(ctx) ((ctx)->bondmaster ? (ctx)->bondmaster : (ctx))
+
 /* CRC32 polynomial for multicast hash calculation */
 #define CRCPOLY 0x04c11db7
 
-/* Size threshold for allocating a cluster mbuf vs. multiple regular mbufs */
-#define MCLTHRESHOLD (MCLBYTES / 2)
+/* Bit position in the multicast hash table for an address: bits 28:23 of the
+ * CRC32 of the address */
+#define SE_MCAST_HASH(crc) (((crc) >> 23) & 0x3f)
+
+/* Is a (16-bit aligned) ethernet address the broadcast address? */
+#define SE_ISBCAST(a) (((unsigned short *)(a))[0] == 0xffff && \
+		       ((unsigned short *)(a))[1] == 0xffff && \
+		       ((unsigned short *)(a))[2] == 0xffff)
+
+/* Offset at which se_get() places a received frame in its first mbuf. This
+ * leaves room to prepend the interface pointer, and puts the payload following
+ * the 14-byte ethernet header on a longword boundary. */
+#define SE_RXALIGN 6
+
+/* Copybreak: frames up to this size are copied into a single small mbuf,
+ * anything bigger goes into a cluster. Chaining small mbufs costs an MGET and a
+ * separate copy across the bus for every MLEN bytes, so a cluster is cheaper as
+ * soon as a frame won't fit in one small mbuf. */
+#define SE_COPYBREAK (MLEN - SE_RXALIGN)
+
+/* Number of times to poll the transmitter while waiting for it to finish a
+ * frame before deciding that it is stuck */
+#define SE_TXDRAIN_SPIN 100000
+
+/* Number of times to poll the DMA engine while waiting for a checksum */
+#define SE_DMA_SPIN 10000
+
+/* Copies shorter than this are done a byte at a time by se_copy() */
+#define SE_COPY_MIN 4
+
+/* Ticks to wait, after a link change, for the transmitter and flow control to
+ * go idle before reconfiguring the MAC regardless */
+#define SE_LINKWAIT (HZ / 2)
+
+/* The flow control watermarks count in units of this many bytes */
+#define SE_WMUNIT 96
+
+/* Amount the high watermark moves by at each adjustment, and room to leave
+ * above it for frames that arrive after PAUSE has gone out (two full-size
+ * frames and a bit), both in SE_WMUNITs */
+#define SE_WMSTEP 8
+#define SE_WMHEADROOM 36
+
+/* Most frame headers se_rxresync() will check before giving up and resetting
+ * the ring. Enough to step over a full-size frame's worth of garbage and
+ * follow a chain of frames from there. */
+#define SE_RESYNC_CHECKS 1024
 
 /* Maximum number of receive-buffer error recoveries to take within a given time
  * period before giving up and disabling the interface */
 #define MAX_RESETS (5)
 #define RESET_COUNT_TIME (HZ * 30)
 
+/*
+Profiling. When built with SE_PROFILE, the driver times its main stages with
+timer 2 of VIA 1, and keeps the results in the context (see struct se_prof in
+if_se.h) for sestat -p to read. Stages are timed from wall-clock time, so a
+stage that gets interrupted counts the time spent in the interrupt too.
+
+We only ever read timer 2. It keeps counting down (and wrapping around) after
+it times out, so it makes a handy free-running 16-bit counter. As far as I can
+tell A/UX doesn't use it; if something does, bear in mind that reading the low
+byte clears its interrupt flag.
+
+When SE_PROFILE isn't defined, all of this compiles to nothing.
+*/
+#ifdef SE_PROFILE
+#ifndef SE_VIA1
+#define SE_VIA1 ((volatile unsigned char *)0x50f00000)
+#endif
+#define VIA_T2CL 0x1000		/* timer 2 counter, low byte */
+#define VIA_T2CH 0x1200		/* timer 2 counter, high byte */
+
+#define SE_PROF_VAR(t) unsigned short t;
+#define SE_PROF_START(t) ((t) = se_prof_now())
+#define SE_PROF_END(ctx, stage, t) \
+	se_prof_record(&(ctx)->prof.sp_stage[stage], \
+		       (unsigned short)((t) - se_prof_now()))
+#else
+#define SE_PROF_VAR(t)
+#define SE_PROF_START(t)
+#define SE_PROF_END(ctx, stage, t)
+#endif
+
+/* Record a trace event in the context's trace ring, if tracing is on (see
+ * struct se_trace in if_se.h). This is done inline, and is meant to be cheap
+ * enough to leave on all the time. It isn't interlocked against interrupts, so
+ * if an interrupt traces something at just the wrong moment, one of the two
+ * events may be lost. */
+#define SE_TRACE(ctx, ev, c, a, b) \
+	do { \
+		if ((ctx)->tracing) { \
+			register struct se_tracerec *tr_; \
+			tr_ = &(ctx)->trace.st_rec[(ctx)->trace.st_next++ & \
+						   (SE_TRACELEN - 1)]; \
+			tr_->tr_time = lbolt; \
+			tr_->tr_event = (ev); \
+			tr_->tr_c = (c); \
+			tr_->tr_a = (a); \
+			tr_->tr_b = (b); \
+		} \
+	} while (0)
+
 #ifdef DEBUG
 /* If we declare our functions as static, they don't show up in the debugger.
  * Using a macro for static means that we can turn static-ness on and off with a
@@ -73,6 +188,7 @@
 #endif
 
 /* external symbols that come from the kernel */
+extern int lbolt; /* clock ticks since boot */
 extern struct ifnet loif;
 extern struct protosw ensw[];
 
@@ -86,12 +202,22 @@ INTERNAL int se_attach __P((struct uba_device *ui));
 
 /* functions exported thru ifnet struct */
 INTERNAL int se_init __P((int unit));
+INTERNAL void se_hwinit __P((struct se_context *ctx));
+INTERNAL void se_hwstop __P((struct se_context *ctx));
 INTERNAL int se_ioctl __P((struct ifnet *ifp, int cmd, unsigned char * data));
 INTERNAL int se_output __P((struct ifnet *ifp, struct mbuf *m0,
 			    struct sockaddr *dst));
 
 /* raw ethernet output */
 INTERNAL int ren_output __P((struct mbuf *m0, struct socket *so));
+#ifdef ETHERLINK
+INTERNAL int ren_usrreq __P((struct socket *so, int req, struct mbuf *m,
+			     struct mbuf *nam, struct mbuf *rights));
+INTERNAL void se_rawupdate __P((void));
+#endif
+
+/* transmit checksum offload query, for use by protocol code */
+int se_txcsum_offload __P((struct ifnet *ifp));
 
 /* driver symbols exported to the kernel */
 void seint(/* struct args *args */);
@@ -101,20 +227,107 @@ struct uba_driver sedriver = { se_probe, se_attach, (unsigned short *)0,
 
 /* Internal functions */
 INTERNAL void se_start __P((int unit));
+INTERNAL int se_txqueue __P((struct se_context *ctx, struct mbuf *m,
+			     unsigned char *edst, int type, int inmbuf));
+INTERNAL struct se_context *se_bondpick __P((struct se_context *ctx,
+					     struct mbuf *m, int isip));
+INTERNAL int se_setbond __P((struct se_context *ctx, int members));
+INTERNAL void se_bondjoin __P((struct se_context *mctx,
+			       struct se_context *ctx));
+INTERNAL void se_bondleave __P((struct se_context *ctx));
+INTERNAL void se_bondfailover __P((struct se_context *ctx));
+INTERNAL void se_txkick __P((struct se_context *ctx));
+INTERNAL void se_txdone __P((struct se_context *ctx, unsigned short eir));
+INTERNAL void se_txdrain __P((struct se_context *ctx));
+INTERNAL void se_txreap __P((struct se_context *ctx));
+INTERNAL void se_txreap_timeout __P((void *p));
+INTERNAL void se_txintr __P((struct se_context *ctx));
+INTERNAL int se_set_txslots __P((struct se_context *ctx, int nslots));
+INTERNAL int se_privioctl __P((struct se_context *ctx, int cmd,
+			       struct ifreq *ifr));
+INTERNAL int se_setparam __P((struct se_context *ctx, int param, int value));
+INTERNAL void se_getstats __P((struct se_context *ctx, struct se_stats *st));
+INTERNAL void se_zerostats __P((struct se_context *ctx));
+INTERNAL int se_getparam __P((struct se_context *ctx, int param, int *value));
 INTERNAL void se_update_linkstate __P((struct se_context *ctx));
+INTERNAL void se_linkchange __P((struct se_context *ctx));
+INTERNAL void se_linkpoll __P((void *p));
 INTERNAL void se_reset_counter_clear __P((void * p));
+INTERNAL void se_rxbuf_init __P((struct se_context *ctx));
+INTERNAL int se_rxbuf_clear __P((struct se_context *ctx));
 INTERNAL void se_rxbuf_reset __P((struct se_context *ctx));
-INTERNAL void se_rpkt __P((struct se_context *ctx));
+INTERNAL void se_rxlost __P((struct se_context *ctx, int taken));
+INTERNAL int se_rxresync __P((struct se_context *ctx, int taken));
+INTERNAL unsigned short se_rxcheck __P((struct se_context *ctx,
+					unsigned short p));
+INTERNAL void se_rxwm_init __P((struct se_context *ctx));
+INTERNAL void se_rxwm_set __P((struct se_context *ctx, int hwm));
+INTERNAL void se_rxwm_sample __P((struct se_context *ctx));
+INTERNAL void se_rxwm_tune __P((struct se_context *ctx));
+INTERNAL int se_rxdrain __P((struct se_context *ctx, int max));
+INTERNAL void se_rxpoll __P((void *p));
+INTERNAL int se_rpkt __P((struct se_context *ctx, struct se_rxbatch *b,
+			  int taken));
+INTERNAL int se_rxwanted __P((unsigned short type));
+#ifdef ETHERLINK
+INTERNAL void se_capture __P((struct se_context *ctx, int len));
+INTERNAL unsigned long se_fexec __P((struct se_finsn *pc, unsigned char *p,
+				     int buflen, int wirelen));
+INTERNAL int se_set_filter __P((struct se_context *ctx, struct se_filter *f));
+#endif
+INTERNAL void se_rxflush __P((struct se_context *ctx, struct se_rxbatch *b));
+INTERNAL int se_rxenqueue __P((struct ifqueue *inq, struct ifqueue *bq));
 INTERNAL void se_update_multicast __P((struct se_context *ctx));
-INTERNAL int se_multicast_hash __P((unsigned char data[6]));
-INTERNAL int se_put __P((struct se_context * ctx, struct mbuf *m));
+INTERNAL void se_update_rxfilter __P((struct se_context *ctx));
+INTERNAL int se_set_pmatch __P((struct se_context *ctx,
+				struct se_pmatch *pm));
+INTERNAL unsigned short se_pmcsum __P((struct se_pmatch *pm));
+INTERNAL int se_add_multi __P((struct se_context *ctx, unsigned char *addr));
+INTERNAL int se_del_multi __P((struct se_context *ctx, unsigned char *addr));
+INTERNAL struct se_mcast *se_find_multi __P((struct se_mcast *mc, int n,
+					     unsigned short *addr));
+INTERNAL unsigned long se_multicast_crc __P((unsigned char *addr));
+INTERNAL int se_put __P((struct se_context * ctx, unsigned short addr,
+			  struct se_txhdr *hdr, struct mbuf *m));
+INTERNAL void se_txcsum __P((struct se_context *ctx, unsigned short addr,
+			     int len));
+INTERNAL unsigned short se_dmacsum __P((struct se_context *ctx,
+					unsigned short addr, unsigned short len,
+					unsigned short seed));
 INTERNAL void se_getbytes __P((struct se_context * ctx, unsigned char * dest, 
 			       unsigned short len));
-INTERNAL struct mbuf *se_get __P((struct se_context * ctx));
+INTERNAL void se_peekbytes __P((struct se_context *ctx, unsigned char *dest,
+				unsigned short len));
+INTERNAL void se_copy __P((unsigned char *src, unsigned char *dst,
+			   unsigned len));
+INTERNAL int se_rxhdr __P((struct se_context * ctx, int taken,
+			   unsigned short *nextp));
+INTERNAL struct mbuf *se_get __P((struct se_context * ctx, int len));
+INTERNAL struct mbuf *se_rxpool_get __P((struct se_context *ctx, int pool));
+#ifdef SE_PROFILE
+INTERNAL unsigned short se_prof_now __P((void));
+INTERNAL void se_prof_record __P((struct se_profstage *ps,
+				  unsigned long ticks));
+#endif
+INTERNAL void se_rxpool_fill __P((void *p));
 
 INTERNAL int se_units[16]; /* unit numbers of devices, indexed by slot number */
 INTERNAL struct se_context se[N_SE];
 
+#ifdef ETHERLINK
+/* Ethernet types that ETHERLINK raw sockets are bound to, as a bitmap indexed
+ * by SE_RAWHASH(), so that the receive path can tell whether anyone wants a
+ * frame without walking the socket list at interrupt level. Rebuilt whenever a
+ * raw socket is opened or closed, by way of ren_usrreq(). */
+#define SE_RAWHASH(type) (((type) ^ ((type) >> 8)) & 0xff)
+INTERNAL unsigned char se_rawtypes[256 / 8];
+INTERNAL int (*se_rawusrreq)();	/* ETHERLINK's own pr_usrreq */
+#endif
+
+#ifdef ENC624J600_REGTRACE
+INTERNAL struct se_regtrace se_regtrace; /* register access log */
+#endif
+
 #ifdef DEBUG
 INTERNAL void se_hexdump(d, len)
 unsigned char * d;
@@ -133,8 +346,6 @@ int len;
 INTERNAL void se_mdump(m)
 struct mbuf * m;
 {
-	int i;
-	unsigned char b;
 	printf("%d@%x ", m->m_len, m->m_off);
 	while (m) {
 		se_hexdump(mtod(m, unsigned char *), m->m_len);
@@ -208,9 +419,27 @@ struct uba_device *ui;
 	ifp->if_ioctl = se_ioctl;
 	ifp->if_output = se_output;
 	ifp->if_flags = IFF_BROADCAST | IFF_NOTRAILERS;
+	ifp->if_snd.ifq_maxlen = SE_TXHDRS;
 	if_attach(ifp);
 	ensw[0].pr_output = ren_output;
+#ifdef ETHERLINK
+	if (ensw[0].pr_usrreq != ren_usrreq) {
+		se_rawusrreq = ensw[0].pr_usrreq;
+		ensw[0].pr_usrreq = ren_usrreq;
+	}
+#endif
 	bzero(ctx->mcast_refcount, 64);
+	ctx->nmcast = 0;
+	ctx->nmcover = 0;
+	ctx->ntxslots = SE_TXSLOTS;
+	ctx->rxstart = SE_TXSLOT(SE_TXSLOTS);
+	ctx->txhead = 0;
+	ctx->txtail = 0;
+	ctx->txcount = 0;
+	ctx->rxbudget = SE_RXBUDGET;
+	ctx->rxpollticks = SE_RXPOLL;
+	ctx->rxpoolsize = SE_RXPOOL;
+	ctx->wmtune = SE_WMTUNE;
 	return 0;
 }
 
@@ -221,37 +450,53 @@ int unit;
 {
 	struct se_context *ctx = &se[unit];
 	struct ifnet *ifp = &ctx->ac.ac_if;
-	int i, s;
 	unsigned short *words;
-	unsigned short tmp, flow_hwm, flow_lwm, rxbuf_size;
 
 	/* can't init yet, address not known */
 	if (ifp->if_addrlist == (struct ifaddr *)0) {
 		return -1;
 	}
 
-	/* Set up receive buffer from end of transmit buffer to end of RAM */
-	ENC624J600_WRITE_REG(ctx->base_address, ERXST, SWAPBYTES(SE_RXSTART));
-	ENC624J600_WRITE_REG(ctx->base_address, ERXTAIL,
-			     SWAPBYTES(SE_RXEND - 2));
+	/* Set local ethernet address */
+	words = (unsigned short *)ctx->ac.ac_enaddr;
+	words[0] = ENC624J600_READ_REG(ctx->base_address, MAADR1);
+	words[1] = ENC624J600_READ_REG(ctx->base_address, MAADR2);
+	words[2] = ENC624J600_READ_REG(ctx->base_address, MAADR3);
+	localetheraddr(ctx->ac.ac_enaddr, NULL);
 
-	/* Start receive FIFO read pointer at beginning of buffer */
-	ctx->rxptr = SE_RXSTART;
+	se_hwinit(ctx);
 
-	/* Set up flow control parameters. We only enable flow control for
-	 * full-duplex links, since half-duplex flow control operates by jamming
-	 * the medium, which is an extremely antisocial thing to do on
-	 * shared-media links (such as if connected to a hub rather than a
-	 * switch).
-	 *
-	 * The high- and low-water-mark parameters (assert flow control at 3/4
-	 * full, deassert at 1/2 full) are completely made up based on gut
-	 * instinct. Should probably tune them at some point. */
-	rxbuf_size = SE_RXEND - SE_RXSTART;
-	flow_hwm = (rxbuf_size - (rxbuf_size / 4)) / 96;
-	flow_lwm = (rxbuf_size / 2) / 96;
-	tmp = (flow_hwm << ERXWM_RXFWM_SHIFT) | (flow_lwm << ERXWM_RXEWM_SHIFT);
-	ENC624J600_WRITE_REG(ctx->base_address, ERXWM, tmp);
+	printf("se%d: init complete. Driver version %s", unit, VERSION);
+	DBGP((" DEBUG BUILD ifp=%x", unit, ifp));
+	printf("\n");
+	return 0;
+}
+
+/* Set the chip up for its ethernet address and our receive filters, and start
+ * it receiving and transmitting. Used by se_init(), and to start the other
+ * members of a bond, which have no address of their own. */
+INTERNAL void se_hwinit(ctx)
+struct se_context *ctx;
+{
+	struct ifnet *ifp = &ctx->ac.ac_if;
+	unsigned short tmp;
+	int s;
+
+	/* Start from an empty transmit ring. We can get here with frames still
+	 * staged, if the interface was marked down and up again or is given
+	 * another address, and a card rejoining a bond may have been stopped
+	 * with its ring indices anywhere. */
+	s = splimp();
+	se_txdrain(ctx);
+	splx(s);
+
+	/* Set up receive buffer and flow control */
+	se_rxbuf_init(ctx);
+
+	/* Fill receive mbuf reserves */
+	se_rxpool_fill(ctx);
+	ctx->rxpool[SE_POOL_SMALL].lowest = ctx->rxpool[SE_POOL_SMALL].count;
+	ctx->rxpool[SE_POOL_CLUST].lowest = ctx->rxpool[SE_POOL_CLUST].count;
 
 	/* Set up 25MHz clock output (used by glue logic for timing control). */
 	tmp = ENC624J600_READ_REG(ctx->base_address, ECON2);
@@ -266,79 +511,322 @@ int unit;
 	       (0x6 << EIDLED_LBCFG_SHIFT); /* LED B indicates activity */
 	ENC624J600_WRITE_REG(ctx->base_address, EIDLED, tmp);
 
-	/* Set local ethernet address */
-	words = (unsigned short *)ctx->ac.ac_enaddr;
-	words[0] = ENC624J600_READ_REG(ctx->base_address, MAADR1);
-	words[1] = ENC624J600_READ_REG(ctx->base_address, MAADR2);
-	words[2] = ENC624J600_READ_REG(ctx->base_address, MAADR3);
-	localetheraddr(ctx->ac.ac_enaddr, NULL);
-
 	/* copy multicast hash table to chip */
 	se_update_multicast(ctx);
 
-	/* Sync MAC duplex configuration with autonegotiated values from PHY */
-	se_update_linkstate(ctx);
-
-	/* Set receive configuration (reject bad-CRC and runt frames, accept
-	 * unicast-to-us, broadcast, and multicast hash matches) */
-	ENC624J600_WRITE_REG(ctx->base_address, ERXFCON,
-			     ERXFCON_CRCEN | ERXFCON_RUNTEN | ERXFCON_UCEN |
-				     ERXFCON_BCEN | ERXFCON_HTEN);
+	/* Set receive filters */
+	se_update_rxfilter(ctx);
 
 	/* Enable packet reception */
 	s = splimp();
 	ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_RXEN);
 
+	/* Sync MAC duplex configuration with autonegotiated values from PHY.
+	 * Transmission waits until this is done. */
+	se_linkchange(ctx);
+
 	/* Mark interface as running */
 	ifp->if_flags |= IFF_RUNNING;
 
 	/* start transmission if we have packets waiting */
 	if (ctx->ac.ac_if.if_snd.ifq_head) {
-		se_start(unit);
+		se_start(ifp->if_unit);
 	}
 
 	/* enable interrupts */
+	ctx->txmasked = 0;
 	ENC624J600_SET_BITS(ctx->base_address, EIE,
 			    EIE_INTIE | EIE_LINKIE | EIE_PKTIE | EIE_RXABTIE |
 				    EIE_PCFULIE | EIE_TXIE | EIE_TXABTIE);
 	
 	splx(s);
-	printf("se%d: init complete. Driver version %s", unit, VERSION);
-	DBGP((" DEBUG BUILD ifp=%x", unit, ifp));
-	printf("\n");
-	return 0;
 }
 
-/* Start a transmit operation */
+/* Stop a card: interrupts and reception off, staged frames sent, and anything
+ * in the receive ring thrown away. Frames on the send queue are left there.
+ * The link, receive and transmit polls that running the card may have set
+ * going are cancelled, so that se_hwinit() can start it again from scratch.
+ * Must be called at splimp(). */
+INTERNAL void se_hwstop(ctx)
+struct se_context *ctx;
+{
+	ENC624J600_CLEAR_BITS(ctx->base_address, EIE, EIE_INTIE);
+	ENC624J600_CLEAR_BITS(ctx->base_address, ECON1, ECON1_RXEN);
+	untimeout(se_linkpoll, ctx);
+	untimeout(se_rxpoll, ctx);
+	untimeout(se_txreap_timeout, ctx);
+	ctx->linkpend = 0;
+	ctx->rxpolling = 0;
+	ctx->txreaping = 0;
+	se_txdrain(ctx);
+	se_rxbuf_clear(ctx);
+	ctx->ac.ac_if.if_flags &= ~IFF_RUNNING;
+}
+
+/* Copy as many packets as will fit from the send queue into free transmit
+ * slots. If the transmitter was idle, the first packet staged is sent straight
+ * away, so that the remaining copies overlap with it being on the wire. Must be
+ * called at splimp(). */
 INTERNAL void se_start(unit)
 int unit;
 {
-	int len;
 	struct se_context *ctx = &se[unit];
+	struct se_txhdr *hdr;
 	struct mbuf *m;
+	unsigned short addr;
+	SE_PROF_VAR(t0)
 
-	/* Bail out if a transmit is already in progress; the queue will be
-	serviced by the ISR instead */
-	if ((ENC624J600_READ_REG(ctx->base_address, ECON1) & ECON1_TXRTS)) {
+	/* Stage nothing new while the MAC is waiting to be reconfigured for a
+	 * change of link state; se_linkpoll() calls us again afterwards */
+	if (ctx->linkpend) {
 		return;
 	}
 
-	/* Take a packet off the send queue */
-	IF_DEQUEUE(&ctx->ac.ac_if.if_snd, m);
-	if (m == 0) {
-		return;
+	while (ctx->txcount < ctx->ntxslots) {
+		/* Take a packet, and its header, off the send queue */
+		IF_DEQUEUE(&ctx->ac.ac_if.if_snd, m);
+		if (m == 0) {
+			return;
+		}
+		hdr = &ctx->txhdr[ctx->txhdrnext];
+		ctx->txhdrnext = (ctx->txhdrnext + 1) % SE_TXHDRS;
+
+		/* Write packet to the next free transmit slot */
+		addr = SE_TXSLOT(ctx->txhead);
+		SE_PROF_START(t0);
+		ctx->txlen[ctx->txhead] = se_put(ctx, addr,
+						 hdr->inmbuf ? 0 : hdr, m);
+		SE_PROF_END(ctx, SE_PROF_TXCOPY, t0);
+		ctx->txclass[ctx->txhead] = SE_CLASS(hdr->type);
+		if (ctx->txcsum) {
+			SE_PROF_START(t0);
+			se_txcsum(ctx, addr, ctx->txlen[ctx->txhead]);
+			SE_PROF_END(ctx, SE_PROF_TXCSUM, t0);
+		}
+		SE_TRACE(ctx, SE_TR_TXSTART, ctx->txhead,
+			 ctx->txlen[ctx->txhead], ctx->txcount + 1);
+		ctx->txhead = (ctx->txhead + 1) % ctx->ntxslots;
+
+		if (ctx->txcount++ == 0) {
+			se_txkick(ctx);
+		}
 	}
+}
 
-	/* Write packet to transmit buffer */
-	len = se_put(ctx, m);
+/* Transmit the frame in the slot at the tail of the transmit ring. The ISR
+ * calls this as soon as the previous frame completes, so back-to-back frames go
+ * out without waiting for a copy. */
+INTERNAL void se_txkick(ctx)
+struct se_context *ctx;
+{
+	ENC624J600_WRITE_REG(ctx->base_address, ETXST,
+			     SWAPBYTES(SE_TXSLOT(ctx->txtail)));
+	ENC624J600_WRITE_REG(ctx->base_address, ETXLEN,
+			     SWAPBYTES(ctx->txlen[ctx->txtail]));
 
 	/* Ready, set, go! */
-	ENC624J600_WRITE_REG(ctx->base_address, ETXST, 0);
-	ENC624J600_WRITE_REG(ctx->base_address, ETXLEN, SWAPBYTES(len));
 	ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_TXRTS);
 }
 
-/* Prepare an mbuf chain for transmission and queue it on the interface */
+/* Account for a completed (or aborted) transmit, retire its slot, and send the
+ * next staged frame, if any. eir is the interrupt flag register as read by the
+ * caller. Must be called at splimp(). */
+INTERNAL void se_txdone(ctx, eir)
+struct se_context *ctx;
+unsigned short eir;
+{
+	register struct se_stats *st = &ctx->stats;
+	struct ifnet *ifp = &SE_IFCTX(ctx)->ac.ac_if;
+	struct se_classstats *cs;
+	unsigned short txstat;
+	int cols;
+
+	txstat = ENC624J600_READ_REG(ctx->base_address, ETXSTAT);
+	SE_TRACE(ctx, SE_TR_TXDONE, ctx->txtail, txstat, eir);
+	cols = (txstat & ETXSTAT_COLCNT_MASK) >> ETXSTAT_COLCNT_SHIFT;
+	ifp->if_collisions += cols;
+	if (txstat & ETXSTAT_DEFER) {
+		st->ss_deferred++;
+	}
+	if (txstat & ETXSTAT_EXDEFER) {
+		st->ss_exdefer++;
+	}
+	if (txstat & ETXSTAT_LATECOL) {
+		st->ss_latecol++;
+	}
+	if (txstat & ETXSTAT_MAXCOL) {
+		st->ss_maxcol++;
+	}
+
+	if (eir & EIR_TXABTIF) {
+		printf("se%d: transmit abort\n", ctx->ac.ac_if.if_unit);
+		ifp->if_oerrors++;
+	} else {
+		ifp->if_opackets++;
+		if (ctx->txcount > 0) {
+			st->ss_obytes += ctx->txlen[ctx->txtail];
+			cs = &st->ss_class[ctx->txclass[ctx->txtail]];
+			cs->cs_opackets++;
+			cs->cs_obytes += ctx->txlen[ctx->txtail];
+		}
+	}
+	ENC624J600_CLEAR_BITS(ctx->base_address, EIR, EIR_TXIF | EIR_TXABTIF);
+
+	if (ctx->txcount > 0) {
+		ctx->txtail = (ctx->txtail + 1) % ctx->ntxslots;
+		if (--ctx->txcount > 0) {
+			se_txkick(ctx);
+		}
+	}
+}
+
+/* Wait for the transmitter to send every staged frame. Called at splimp(), so
+ * completions are picked up by polling rather than by the ISR. If the
+ * transmitter appears to be stuck, the remaining frames are abandoned. Either
+ * way, the transmit ring is left empty, starting from slot 0. */
+INTERNAL void se_txdrain(ctx)
+struct se_context *ctx;
+{
+	long spin;
+
+	while (ctx->txcount > 0) {
+		for (spin = 0; ENC624J600_READ_REG(ctx->base_address, ECON1) &
+				       ECON1_TXRTS;
+		     spin++) {
+			if (spin > SE_TXDRAIN_SPIN) {
+				break;
+			}
+		}
+		if (spin > SE_TXDRAIN_SPIN) {
+			printf("se%d: transmitter stuck, %d frame(s) dropped\n",
+			       ctx->ac.ac_if.if_unit, ctx->txcount);
+			ctx->ac.ac_if.if_oerrors += ctx->txcount;
+			ENC624J600_CLEAR_BITS(ctx->base_address, ECON1,
+					      ECON1_TXRTS);
+			ctx->txcount = 0;
+			break;
+		}
+		se_txdone(ctx, ENC624J600_READ_REG(ctx->base_address, EIR));
+	}
+
+	/* An abandoned frame would leave txtail behind txhead, and our callers
+	 * may be about to change the slot count, so start the ring afresh */
+	ctx->txhead = 0;
+	ctx->txtail = 0;
+}
+
+/* Pick up a transmit completion without waiting for the interrupt, and refill
+ * the transmit slots from the send queue. Used in lazy transmit mode. Must be
+ * called at splimp(). */
+INTERNAL void se_txreap(ctx)
+struct se_context *ctx;
+{
+	unsigned short eir;
+
+	if (ctx->txcount > 0) {
+		eir = ENC624J600_READ_REG(ctx->base_address, EIR);
+		if (eir & (EIR_TXIF | EIR_TXABTIF)) {
+			ctx->stats.ss_txreaped++;
+			se_txdone(ctx, eir);
+		}
+	}
+	if (ctx->ac.ac_if.if_snd.ifq_head) {
+		se_start(ctx->ac.ac_if.if_unit);
+	}
+	se_txintr(ctx);
+}
+
+/* Called by timeout() while the transmit interrupt is masked */
+INTERNAL void se_txreap_timeout(p)
+void *p;
+{
+	struct se_context *ctx = (struct se_context *)p;
+	int s;
+
+	s = splimp();
+	ctx->txreaping = 0;
+	if (ctx->txmasked) {
+		se_txreap(ctx);
+	}
+	splx(s);
+}
+
+/* Decide whether the next transmit completion needs an interrupt. While there
+ * is more to send after the frame on the wire, it does, so that the next frame
+ * goes as soon as the transmitter is free. In lazy mode, once the last frame is
+ * on the wire it doesn't, as nothing is waiting on it: its slot is reaped the
+ * next time something is sent, with a timeout as a backstop. If the completion
+ * has already happened, unmasking the interrupt makes it fire straight away, so
+ * nothing is missed. Must be called at splimp(). */
+INTERNAL void se_txintr(ctx)
+struct se_context *ctx;
+{
+	if (ctx->txlazy && ctx->txcount <= 1 &&
+	    !ctx->ac.ac_if.if_snd.ifq_head) {
+		if (!ctx->txmasked) {
+			ENC624J600_CLEAR_BITS(ctx->base_address, EIE,
+					      EIE_TXIE);
+			ctx->txmasked = 1;
+		}
+		if (ctx->txcount > 0 && !ctx->txreaping) {
+			ctx->txreaping = 1;
+			timeout(se_txreap_timeout, ctx, 1);
+		}
+	} else if (ctx->txmasked) {
+		ENC624J600_SET_BITS(ctx->base_address, EIE, EIE_TXIE);
+		ctx->txmasked = 0;
+	}
+}
+
+/* Re-carve buffer memory into nslots transmit slots, with the rest going to the
+ * receive ring. If the interface is running, the frames already staged for
+ * transmit are sent first, and anything waiting in the receive ring is
+ * dropped. */
+INTERNAL int se_set_txslots(ctx, nslots)
+struct se_context *ctx;
+int nslots;
+{
+	struct ifnet *ifp = &ctx->ac.ac_if;
+	int s, dropcnt;
+
+	if (nslots < 1 || nslots > SE_MAXTXSLOTS) {
+		return EINVAL;
+	}
+
+	s = splimp();
+
+	/* Quiesce the receiver and transmitter */
+	ENC624J600_CLEAR_BITS(ctx->base_address, ECON1, ECON1_RXEN);
+	se_txdrain(ctx);
+
+	ctx->ntxslots = nslots;
+	ctx->rxstart = SE_TXSLOT(nslots);
+
+	/* If we're not running, se_init() will program the new receive ring
+	 * when the interface comes up */
+	if (ifp->if_flags & IFF_RUNNING) {
+		dropcnt = se_rxbuf_clear(ctx);
+		if (dropcnt) {
+			printf("se%d: dropped %d packets while resizing rx "
+			       "buffer\n", ifp->if_unit, dropcnt);
+		}
+		se_rxbuf_init(ctx);
+		ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_RXEN);
+
+		if (ifp->if_snd.ifq_head) {
+			se_start(ifp->if_unit);
+		}
+	}
+
+	splx(s);
+	printf("se%d: %d tx slots, %d bytes of rx buffer\n", ifp->if_unit,
+	       nslots, SE_RXEND - ctx->rxstart);
+	return 0;
+}
+
+/* Prepare an mbuf chain for transmission and queue it on the interface. The
+ * ethernet header isn't added to the chain, but queued alongside it, for
+ * se_start() to write into the transmit slot. */
 INTERNAL int se_output(ifp, m0, dst)
 struct ifnet *ifp;
 struct mbuf *m0;
@@ -351,8 +839,11 @@ struct sockaddr *dst;
 	register struct mbuf *m = m0;
 	struct mbuf *mcopy = (struct mbuf *)0;
 	register struct ether_header *header;
-	int usetrailers;
+	struct se_context *to;
+	int usetrailers, inmbuf;
+	SE_PROF_VAR(t0)
 
+	SE_PROF_START(t0);
 	if ((ifp->if_flags & (IFF_UP | IFF_RUNNING)) !=
 	    (IFF_UP | IFF_RUNNING)) {
 		/* Don't transmit on a down interface */
@@ -395,6 +886,7 @@ struct sockaddr *dst;
 #endif
 	case AF_ETHERLINK:
 		header = mtod(m, struct ether_header *);
+		type = header->ether_type;
 		goto gotheader;
 
 	default:
@@ -404,45 +896,30 @@ struct sockaddr *dst;
 		goto bad;
 	}
 
-	/* Add local net header.  If no space in first mbuf (or first mbuf is
-	 * cluster), allocate another */
-	if (m->m_off > MMAXOFF ||
-	    MMINOFF + sizeof(struct ether_header) > m->m_off) {
-		m = m_get(M_DONTWAIT, MT_HEADER);
-		if (m == 0) {
-			error = ENOBUFS;
-			goto bad;
-		}
-		m->m_next = m0;
-		m->m_off = MMINOFF;
-		m->m_len = sizeof(struct ether_header);
-	} else {
-		m->m_off -= sizeof(struct ether_header);
-		m->m_len += sizeof(struct ether_header);
-	}
-
-	header = mtod(m, struct ether_header *);
-	header->ether_type = type;
-	bcopy((unsigned char *)edst, (unsigned char *)header->ether_dhost,
-	      sizeof(edst));
+	/* edst and type go in the header ring, below */
+	inmbuf = 0;
+	goto queue;
 
 gotheader:
-	/* Fill in the source address. */
+	/* The chain already has a header. Fill in the source address. */
 	bcopy((unsigned char *)ctx->ac.ac_enaddr,
 	      (unsigned char *)header->ether_shost,
 	      sizeof(header->ether_shost));
+	inmbuf = 1;
+
+queue:
+	SE_PROF_END(ctx, SE_PROF_OUTPUT, t0);
 
-	/* Queue message on interface, and start output if interface not yet
-	* active. */
+	/* Queue message on interface (or, if it is the master of a bond, on
+	 * whichever card of the bond this flow goes out on), and start output
+	 * if interface not yet active. */
 	s = splimp();
-	if (IF_QFULL(&ifp->if_snd)) {
-		IF_DROP(&ifp->if_snd);
-		splx(s);
+	to = se_bondpick(ctx, m, !inmbuf && type == ETHERTYPE_IP);
+	error = se_txqueue(to ? to : ctx, m, edst, type, inmbuf);
+	splx(s);
+	if (error) {
 		goto bad;
 	}
-	IF_ENQUEUE(&ifp->if_snd, m);
-	se_start(ifp->if_unit);
-	splx(s);
 	return (mcopy ? looutput(&loif, mcopy, dst) : 0);
 
 bad:
@@ -453,151 +930,670 @@ bad:
 	return (error);
 }
 
-INTERNAL int ren_output(m, so)
+/* Put a frame on a card's send queue, along with its ethernet header (unless
+ * inmbuf is set, in which case the chain has its own, and only its type is
+ * kept, for the statistics), and get it going. Returns ENOBUFS if the queue is
+ * full, in which case the caller still owns m. Must be called at splimp(). */
+INTERNAL int se_txqueue(ctx, m, edst, type, inmbuf)
+struct se_context *ctx;
 struct mbuf *m;
-struct socket *so;
+unsigned char *edst;
+int type;
+int inmbuf;
 {
-	struct rawcb *rp = sotorawcb(so);
-	struct ifaddr *ifa;
-	struct ifnet *ifp;
-	int error;
+	struct ifnet *ifp = &ctx->ac.ac_if;
+	register struct se_txhdr *hdr;
 
-	if (rp == (struct rawcb *)0) {
-		error = ENOPROTOOPT;
-		goto bad;
-	}
-	switch (rp->rcb_proto.sp_family) {
-#ifdef ETHERLINK
-	case AF_ETHERLINK: {
-		struct sockaddr_in inether, *sin;
-		if ((rp->rcb_flags & RAW_LADDR) == 0) {
-			error = EADDRNOTAVAIL;
-			goto bad;
-		}
-		bzero((unsigned char *)&inether, (unsigned)sizeof(inether));
-		inether.sin_family = AF_INET;
-		sin = (struct sockaddr_in *)&rp->rcb_laddr;
-		inether.sin_addr = sin->sin_addr;
-		if (inether.sin_addr.s_addr &&
-		    (ifa = ifa_ifwithaddr((struct sockaddr *)&inether)) == 0) {
-			error = EADDRNOTAVAIL;
-			goto bad;
-		}
-		break;
-	}
-#endif
-	default:
-		error = EPROTOTYPE;
-		goto bad;
-		break;
+	if (IF_QFULL(&ifp->if_snd) || ifp->if_snd.ifq_len >= SE_TXHDRS) {
+		IF_DROP(&ifp->if_snd);
+		return ENOBUFS;
 	}
-	ifp = ifa->ifa_ifp;
-	if (ifp) {
-		return ((*ifp->if_output)(ifp, m, &rp->rcb_laddr));
+
+	/* The header ring runs in step with the send queue. Its entries are
+	 * found from the queue length, rather than by keeping a separate
+	 * count, so that they stay in step if if_down() flushes the queue. */
+	hdr = &ctx->txhdr[(ctx->txhdrnext + ifp->if_snd.ifq_len) % SE_TXHDRS];
+	hdr->inmbuf = inmbuf;
+	hdr->type = type;
+	if (!inmbuf) {
+		bcopy(edst, hdr->dhost, sizeof(hdr->dhost));
 	}
-	error = EADDRNOTAVAIL;
-bad:
-	if (m != 0) {
-		m_freem(m);
+	IF_ENQUEUE(&ifp->if_snd, m);
+	SE_TRACE(ctx, SE_TR_OUTPUT, 0, ifp->if_snd.ifq_len, 0);
+	if (ctx->txlazy) {
+		se_txreap(ctx);
+	} else {
+		se_start(ifp->if_unit);
 	}
-	return error;
+	return 0;
 }
 
-/* Interrupt service routine */
-void seint(args)
-struct args *args;
+/* Choose which card of ctx's bond sends a frame, or return 0 if ctx isn't the
+ * master of a bond or none of its cards has a link. IP frames (isip) are spread
+ * over the cards with a link by a hash of their addresses, and of their ports
+ * too for unfragmented TCP and UDP, so that the frames of a flow all go the
+ * same way and stay in order. (Fragments are hashed on addresses only, as only
+ * the first carries the ports.) Anything else goes on the first card with a
+ * link. */
+INTERNAL struct se_context *se_bondpick(ctx, m, isip)
+struct se_context *ctx;
+struct mbuf *m;
+int isip;
 {
-	int unit = se_units[args->a_dev];
-	int s;
-	register struct se_context *ctx = &se[unit];
-	volatile unsigned short *ir;
-	unsigned short tail;
+	struct se_context *up[N_SE];
+	register struct ip *ip;
+	register unsigned long h = 0;
+	int i, n, hlen;
 
-	if (unit < 0 || unit > N_SE) {
-		printf("se: interrupt from mystery unit #%d\n", unit);
-		panic("se");
+	if (!ctx->bondmask) {
+		return 0;
+	}
+	for (i = 0, n = 0; i < N_SE; i++) {
+		if ((ctx->bondmask & (1 << i)) && se[i].linkup &&
+		    (se[i].ac.ac_if.if_flags & IFF_RUNNING)) {
+			up[n++] = &se[i];
+		}
+	}
+	if (n == 0) {
+		return 0;
 	}
 
-	if (ctx->base_address == NULL) {
-		printf("se: interrupt from uninitialised unit #%d\n", unit);
-		panic("se");
+	if (isip && m->m_len >= (int)sizeof(struct ip)) {
+		ip = mtod(m, struct ip *);
+		hlen = ip->ip_hl << 2;
+		h = ip->ip_src.s_addr ^ ip->ip_dst.s_addr;
+		if ((ip->ip_off & (IP_MF | IP_OFFMASK)) == 0 &&
+		    (ip->ip_p == IPPROTO_TCP || ip->ip_p == IPPROTO_UDP) &&
+		    m->m_len >= hlen + 4) {
+			h ^= *(unsigned long *)((caddr_t)ip + hlen);
+		}
+		h ^= h >> 16;
+		h ^= h >> 8;
 	}
+	return up[(h & 0xff) % n];
+}
 
-	ir = ENC624J600_REG(ctx->base_address, EIR);
+/* Set the members of the bond that ctx is master of (SIOCSSEBOND). Cards
+ * leaving the bond are stopped; cards joining are started. Must be called at
+ * splimp(). */
+INTERNAL int se_setbond(ctx, members)
+struct se_context *ctx;
+int members;
+{
+	int unit = ctx->ac.ac_if.if_unit;
+	struct se_context *mc;
+	int i;
 
-	/* Link state has changed; update flow control and duplex parameters */
-	if (*ir & EIR_LINKIF) {
-		printf("se%d: link %s\n", unit,
-		       (ENC624J600_READ_REG(ctx->base_address, ESTAT) &
-			ESTAT_PHYLNK) ? "up" : "down");
-		se_update_linkstate(ctx);
-		ENC624J600_CLEAR_BITS(ctx->base_address, EIR, EIR_LINKIF);
+	if (ctx->bondmaster && ctx->bondmaster != ctx) {
+		/* already a member of someone else's bond */
+		return EBUSY;
+	}
+	if (!(ctx->ac.ac_if.if_flags & IFF_RUNNING)) {
+		/* we need to know our address to give it to the others */
+		return ENETDOWN;
+	}
+	members |= 1 << unit;
+	if (members & ~((1 << N_SE) - 1)) {
+		return EINVAL;
 	}
 
-	/* Transmit complete or abort */
-	if (*ir & (EIR_TXIF | EIR_TXABTIF)) {
-		if (*ir & EIR_TXABTIF) {
-			printf("se%d: transmit abort\n");
-			ctx->ac.ac_if.if_oerrors++;
-		} else {
-			ctx->ac.ac_if.if_opackets++;
+	/* Check the newcomers are free to join */
+	for (i = 0; i < N_SE; i++) {
+		mc = &se[i];
+		if (i == unit || !(members & (1 << i)) ||
+		    (ctx->bondmask & (1 << i))) {
+			continue;
 		}
-		ENC624J600_CLEAR_BITS(ctx->base_address, EIR,
-				      EIR_TXIF | EIR_TXABTIF);
-		/* Start transmitting the next queued packet */
+		if (mc->base_address == NULL) {
+			return ENXIO;
+		}
+		if (mc->bondmaster || mc->ac.ac_if.if_addrlist) {
+			return EBUSY;
+		}
+	}
+
+	for (i = 0; i < N_SE; i++) {
+		if (i != unit && (ctx->bondmask & (1 << i)) &&
+		    !(members & (1 << i))) {
+			se_bondleave(&se[i]);
+		}
+	}
+
+	if (members == (1 << unit)) {
+		/* Just us left */
+		ctx->bondmask = 0;
+		ctx->bondmaster = 0;
+		return 0;
+	}
+
+	ctx->bondmaster = ctx;
+	for (i = 0; i < N_SE; i++) {
+		if (i != unit && (members & (1 << i)) &&
+		    !(ctx->bondmask & (1 << i))) {
+			ctx->bondmask |= 1 << i;
+			se_bondjoin(ctx, &se[i]);
+		}
+	}
+	ctx->bondmask |= 1 << unit;
+	return 0;
+}
+
+/* Add card ctx to the bond mastered by mctx: give it the master's ethernet
+ * address, and start it up. Must be called at splimp(). */
+INTERNAL void se_bondjoin(mctx, ctx)
+struct se_context *mctx;
+struct se_context *ctx;
+{
+	unsigned short *words;
+
+	/* Keep the card's own address, to give back when it leaves */
+	ctx->ownaddr[0] = ENC624J600_READ_REG(ctx->base_address, MAADR1);
+	ctx->ownaddr[1] = ENC624J600_READ_REG(ctx->base_address, MAADR2);
+	ctx->ownaddr[2] = ENC624J600_READ_REG(ctx->base_address, MAADR3);
+
+	bcopy(mctx->ac.ac_enaddr, ctx->ac.ac_enaddr,
+	      sizeof(ctx->ac.ac_enaddr));
+	words = (unsigned short *)ctx->ac.ac_enaddr;
+	ENC624J600_WRITE_REG(ctx->base_address, MAADR1, words[0]);
+	ENC624J600_WRITE_REG(ctx->base_address, MAADR2, words[1]);
+	ENC624J600_WRITE_REG(ctx->base_address, MAADR3, words[2]);
+
+	ctx->bondmaster = mctx;
+	se_hwinit(ctx);
+	printf("se%d: joined bond with se%d\n", ctx->ac.ac_if.if_unit,
+	       mctx->ac.ac_if.if_unit);
+}
+
+/* Take card ctx out of its bond: stop it, hand whatever is on its send queue to
+ * the rest of the bond, and give it its own address back. Must be called at
+ * splimp(). */
+INTERNAL void se_bondleave(ctx)
+struct se_context *ctx;
+{
+	struct se_context *mctx = ctx->bondmaster;
+	unsigned short *words;
+
+	mctx->bondmask &= ~(1 << ctx->ac.ac_if.if_unit);
+	se_hwstop(ctx);
+	se_bondfailover(ctx);
+	ctx->bondmaster = 0;
+	ctx->linkup = 0;
+
+	ENC624J600_WRITE_REG(ctx->base_address, MAADR1, ctx->ownaddr[0]);
+	ENC624J600_WRITE_REG(ctx->base_address, MAADR2, ctx->ownaddr[1]);
+	ENC624J600_WRITE_REG(ctx->base_address, MAADR3, ctx->ownaddr[2]);
+	words = (unsigned short *)ctx->ac.ac_enaddr;
+	words[0] = ctx->ownaddr[0];
+	words[1] = ctx->ownaddr[1];
+	words[2] = ctx->ownaddr[2];
+	printf("se%d: left bond with se%d\n", ctx->ac.ac_if.if_unit,
+	       mctx->ac.ac_if.if_unit);
+}
+
+/* Move the frames waiting on a bonded card's send queue over to the other cards
+ * of its bond, when it has lost its link or is leaving. If no other card has a
+ * link, they stay where they are. Frames already staged in the card's transmit
+ * slots are left to the card. Must be called at splimp(). */
+INTERNAL void se_bondfailover(ctx)
+struct se_context *ctx;
+{
+	struct se_context *mctx = ctx->bondmaster;
+	struct se_context *to;
+	struct se_txhdr *hdr;
+	struct mbuf *m;
+
+	to = se_bondpick(mctx, (struct mbuf *)0, 0);
+	if (to == 0 || to == ctx) {
+		return;
+	}
+
+	for (;;) {
+		IF_DEQUEUE(&ctx->ac.ac_if.if_snd, m);
+		if (m == 0) {
+			break;
+		}
+		hdr = &ctx->txhdr[ctx->txhdrnext];
+		ctx->txhdrnext = (ctx->txhdrnext + 1) % SE_TXHDRS;
+
+		to = se_bondpick(mctx, m,
+				 !hdr->inmbuf && hdr->type == ETHERTYPE_IP);
+		if (to == 0 || to == ctx ||
+		    se_txqueue(to, m, hdr->dhost, hdr->type, hdr->inmbuf)) {
+			m_freem(m);
+			mctx->ac.ac_if.if_oerrors++;
+		}
+	}
+}
+
+INTERNAL int ren_output(m, so)
+struct mbuf *m;
+struct socket *so;
+{
+	struct rawcb *rp = sotorawcb(so);
+	struct ifaddr *ifa;
+	struct ifnet *ifp;
+	int error;
+
+	if (rp == (struct rawcb *)0) {
+		error = ENOPROTOOPT;
+		goto bad;
+	}
+	switch (rp->rcb_proto.sp_family) {
+#ifdef ETHERLINK
+	case AF_ETHERLINK: {
+		struct sockaddr_in inether, *sin;
+		if ((rp->rcb_flags & RAW_LADDR) == 0) {
+			error = EADDRNOTAVAIL;
+			goto bad;
+		}
+		bzero((unsigned char *)&inether, (unsigned)sizeof(inether));
+		inether.sin_family = AF_INET;
+		sin = (struct sockaddr_in *)&rp->rcb_laddr;
+		inether.sin_addr = sin->sin_addr;
+		/* Without an address there's no telling which interface
+		 * was meant */
+		if (inether.sin_addr.s_addr == 0 ||
+		    (ifa = ifa_ifwithaddr((struct sockaddr *)&inether)) == 0) {
+			error = EADDRNOTAVAIL;
+			goto bad;
+		}
+		break;
+	}
+#endif
+	default:
+		error = EPROTOTYPE;
+		goto bad;
+		break;
+	}
+	ifp = ifa->ifa_ifp;
+	if (ifp) {
+		return ((*ifp->if_output)(ifp, m, &rp->rcb_laddr));
+	}
+	error = EADDRNOTAVAIL;
+bad:
+	if (m != 0) {
+		m_freem(m);
+	}
+	return error;
+}
+
+#ifdef ETHERLINK
+/* ETHERLINK raw socket requests go through here on their way to the raw socket
+ * code, so that se_rawtypes can be kept up to date as sockets come and go */
+INTERNAL int ren_usrreq(so, req, m, nam, rights)
+struct socket *so;
+int req;
+struct mbuf *m;
+struct mbuf *nam;
+struct mbuf *rights;
+{
+	int error;
+
+	error = (*se_rawusrreq)(so, req, m, nam, rights);
+	switch (req) {
+	case PRU_ATTACH:
+	case PRU_DETACH:
+	case PRU_ABORT:
+		se_rawupdate();
+		break;
+	}
+	return error;
+}
+
+/* Rebuild se_rawtypes from the raw socket list. A socket bound to type 0 wants
+ * everything. Two types can share a bit, which only means that the odd frame
+ * nobody wants gets copied and then thrown away by raw_input(). */
+INTERNAL void se_rawupdate()
+{
+	unsigned char types[sizeof(se_rawtypes)];
+	register struct rawcb *rp;
+	register unsigned short h;
+	register unsigned i;
+	int s;
+
+	bzero((caddr_t)types, sizeof(types));
+	s = splnet();
+	for (rp = rawcb.rcb_next; rp != &rawcb; rp = rp->rcb_next) {
+		if (rp->rcb_proto.sp_family != PF_ETHERLINK) {
+			continue;
+		}
+		if (rp->rcb_proto.sp_protocol == 0) {
+			for (i = 0; i < sizeof(types); i++) {
+				types[i] = 0xff;
+			}
+			break;
+		}
+		h = SE_RAWHASH(rp->rcb_proto.sp_protocol);
+		types[h >> 3] |= 1 << (h & 7);
+	}
+	(void)splimp();
+	bcopy((caddr_t)types, (caddr_t)se_rawtypes, sizeof(types));
+	splx(s);
+}
+#endif
+
+/* Interrupt service routine */
+void seint(args)
+struct args *args;
+{
+	int unit = se_units[args->a_dev];
+	int s;
+	register struct se_context *ctx = &se[unit];
+	register unsigned short eir;
+	unsigned short estat;
+	SE_PROF_VAR(t0)
+
+	SE_PROF_START(t0);
+	if (unit < 0 || unit > N_SE) {
+		printf("se: interrupt from mystery unit #%d\n", unit);
+		panic("se");
+	}
+
+	if (ctx->base_address == NULL) {
+		printf("se: interrupt from uninitialised unit #%d\n", unit);
+		panic("se");
+	}
+
+	/* Read the interrupt flags once; each handler below clears the flags it
+	 * deals with */
+	eir = ENC624J600_READ_REG(ctx->base_address, EIR);
+	SE_TRACE(ctx, SE_TR_INTR, 0, eir, 0);
+
+	/* See how full the receive ring is getting */
+	se_rxwm_sample(ctx);
+
+	/* Link state has changed. Flow control and duplex parameters are
+	 * updated later, from a timeout, as it may be a while before the
+	 * chip is ready for them to be changed. */
+	if (eir & EIR_LINKIF) {
+		estat = ENC624J600_READ_REG(ctx->base_address, ESTAT);
+		SE_TRACE(ctx, SE_TR_LINK, 0, estat, 0);
+		ENC624J600_CLEAR_BITS(ctx->base_address, EIR, EIR_LINKIF);
+		s = splimp();
+		se_linkchange(ctx);
+		splx(s);
+	}
+
+	/* Transmit complete or abort. In lazy transmit mode, this may be a
+	 * completion whose interrupt was masked, which we may as well pick up
+	 * while we're here. */
+	if (eir & (EIR_TXIF | EIR_TXABTIF)) {
 		s = splimp();
+		/* Send the next staged frame, if any, before refilling the ring
+		 * from the send queue */
+		ctx->stats.ss_txintrs++;
+		se_txdone(ctx, eir);
 		if (ctx->ac.ac_if.if_snd.ifq_head) {
 			se_start(unit);
 		}
+		se_txintr(ctx);
 		splx(s);
 	}
 
 	/* Recieve abort interrupt. Not much we can do here except note it */
-	if (*ir & EIR_RXABTIF) {
+	if (eir & EIR_RXABTIF) {
 		ENC624J600_CLEAR_BITS(ctx->base_address, EIR, EIR_RXABTIF);
 		printf("se%d: receive overflow, packet(s) dropped\n", unit);
 		ctx->ac.ac_if.if_ierrors++;
+		ctx->stats.ss_rxabort++;
+		ctx->wmaborts++;
 	}
 
-	/* Handle any received packets */
-	while (*ir & EIR_PKTIF) {
-		ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_PKTDEC);
-		se_rpkt(ctx);
+	/* Packet counter full. The chip can't count any more packets, so
+	 * further ones will be dropped until we've taken some off the ring,
+	 * which the receive handling below will do. */
+	if (eir & EIR_PCFULIF) {
+		ENC624J600_CLEAR_BITS(ctx->base_address, EIR, EIR_PCFULIF);
+		ctx->stats.ss_pcfull++;
+	}
+
+	/* Handle received packets, up to our budget. If that doesn't empty the
+	 * ring, we're being flooded, so stop taking receive interrupts and
+	 * poll instead. In deferred-receive mode, go straight to polling. */
+	if ((eir & EIR_PKTIF) && !ctx->rxpolling) {
+		if (ctx->softrx) {
+			ENC624J600_CLEAR_BITS(ctx->base_address, EIE,
+					      EIE_PKTIE);
+			ctx->rxpolling = 1;
+			timeout(se_rxpoll, ctx, 1);
+			SE_PROF_END(ctx, SE_PROF_INTR, t0);
+			return;
+		}
+
+		do {
+			ctx->stats.ss_rxintrs++;
+			ctx->stats.ss_rxintr_frames +=
+				se_rxdrain(ctx, ctx->rxbudget);
+			eir = ENC624J600_READ_REG(ctx->base_address, EIR);
+		} while ((eir & EIR_PKTIF) && ctx->rxbudget == 0);
+
+		if (eir & EIR_PKTIF) {
+			ENC624J600_CLEAR_BITS(ctx->base_address, EIE,
+					      EIE_PKTIE);
+			ctx->rxpolling = 1;
+			timeout(se_rxpoll, ctx, ctx->rxpollticks);
+		}
 	}
 
+	SE_PROF_END(ctx, SE_PROF_INTR, t0);
 	return;
 }
 
+/* Called by timeout() while in polled receive mode. Takes up to a budget's
+ * worth of packets off the receive ring, then either comes back for more on the
+ * next poll, or goes back to interrupt mode if the ring is empty.
+ *
+ * Normally we only poll to ride out a flood, and stay at splimp() throughout,
+ * as the ISR would. In deferred-receive mode (softrx), this is where all
+ * receive work is done, and the copying out of the ring is done without
+ * raising the priority level, which is the point of it. The receive interrupt
+ * is masked while we're polling, so the ISR leaves the receive ring alone, and
+ * se_rpkt() and se_rxflush() go to splimp() to hand packets to the protocols.
+ *
+ * Even with no budget (rxbudget 0), each call only takes the packets that were
+ * in the ring when it started (see se_rxdrain()), so a long burst can't keep
+ * us here: we come back for the rest on the next tick, and the clock and
+ * everything else at callout priority get a look in between. */
+INTERNAL void se_rxpoll(p)
+void *p;
+{
+	struct se_context * ctx = (struct se_context *) p;
+	int s, soft = ctx->softrx;
+
+	if (!soft) {
+		s = splimp();
+	}
+	ctx->stats.ss_rxpolls++;
+	ctx->stats.ss_rxpoll_ticks += ctx->rxpollticks;
+	ctx->stats.ss_rxpoll_frames += se_rxdrain(ctx, ctx->rxbudget);
+
+	if (soft) {
+		s = splimp();
+	}
+	if (ctx->txmasked) {
+		se_txreap(ctx);
+	}
+	if (ENC624J600_READ_REG(ctx->base_address, EIR) & EIR_PKTIF) {
+		timeout(se_rxpoll, ctx, ctx->rxpollticks);
+	} else {
+		/* If a packet arrives between the test above and here, the
+		 * interrupt fires as soon as it's unmasked, so nothing is
+		 * missed */
+		ctx->rxpolling = 0;
+		ENC624J600_SET_BITS(ctx->base_address, EIE, EIE_PKTIE);
+	}
+	splx(s);
+}
+
+/* Take as many packets off the receive ring as the chip says are waiting, up to
+ * max (0 for no limit), and pass them up. Their ring space is released, and the
+ * chip's packet counter decremented, in one go at the end. IP and AppleTalk
+ * packets are then queued for their protocols under a single spl section.
+ * Returns the number of packets taken off the ring.
+ *
+ * Only packets that were already in the ring when we started are taken: we
+ * note the packet count and ERXHEAD on the way in, and stop at whichever comes
+ * first. Anything that arrives meanwhile is left for the next pass, so however
+ * fast packets come in, one pass never runs for longer than it takes to empty
+ * the ring once. */
+INTERNAL int se_rxdrain(ctx, max)
+struct se_context *ctx;
+int max;
+{
+	struct se_rxbatch b;
+	int count, n, taken;
+	unsigned short head, tail;
+	SE_PROF_VAR(t0)
+	SE_PROF_VAR(t1)
+
+	SE_PROF_START(t0);
+	count = (ENC624J600_READ_REG(ctx->base_address, ESTAT) &
+		 ESTAT_PKTCNT_MASK) >> ESTAT_PKTCNT_SHIFT;
+	if (max > 0 && count > max) {
+		count = max;
+	}
+	head = ENC624J600_READ_REG(ctx->base_address, ERXHEAD);
+	head = SWAPBYTES(head);
+
+	/* (If the count says there's a packet but we're already at ERXHEAD,
+	 * we've lost our place, and se_rpkt() will find out and recover.) */
+	bzero((caddr_t)&b, sizeof(b));
+	for (n = 0; n < count && (n == 0 || ctx->rxptr != head); n++) {
+		SE_PROF_START(t1);
+		if (!se_rpkt(ctx, &b, n)) {
+			/* The ring has been resynced or reset, which released
+			 * everything before the read pointer, so there is
+			 * nothing left for us to release */
+			n = 0;
+			break;
+		}
+		SE_PROF_END(ctx, SE_PROF_RXPKT, t1);
+	}
+	taken = n;
+	SE_TRACE(ctx, SE_TR_RXDRAIN, ctx->rxpolling, count, taken);
+
+	if (n > 0) {
+		/* tail of receive ring buffer must be at least 2 bytes behind
+		 * our read pointer */
+		tail = ctx->rxptr - 2;
+		if (tail < ctx->rxstart) {
+			tail = SE_RXEND - 2;
+		}
+		ENC624J600_WRITE_REG(ctx->base_address, ERXTAIL,
+				     SWAPBYTES(tail));
+		while (n--) {
+			ENC624J600_SET_BITS(ctx->base_address, ECON1,
+					    ECON1_PKTDEC);
+		}
+	}
+
+	se_rxflush(ctx, &b);
+	SE_PROF_END(ctx, SE_PROF_RXDRAIN, t0);
+	return taken;
+}
+
 struct sockaddr redst = { AF_ETHERLINK };
 struct sockaddr resrc = { AF_ETHERLINK };
 struct sockproto reproto = { PF_ETHERLINK };
 
-/* Packet-reception handler */
-INTERNAL void se_rpkt(ctx)
+/* Packet-reception handler. Takes the packet at the read pointer off the
+ * receive ring and passes it up. IP and AppleTalk packets are added to the
+ * batch b, to be queued by se_rxflush(). taken is the number of frames already
+ * taken off the ring in this receive pass, but not yet released to the chip.
+ * Returns 0 if the receive ring was found to be corrupt and had to be resynced
+ * or reset, 1 otherwise. */
+INTERNAL int se_rpkt(ctx, b, taken)
 struct se_context *ctx;
+struct se_rxbatch *b;
+int taken;
 {
-	struct ifnet * ifp = &ctx->ac.ac_if;
+	struct se_context *ictx = SE_IFCTX(ctx);
+	struct ifnet * ifp = &ictx->ac.ac_if;
 	struct ether_header * eh;
-	register unsigned short len;
+	struct ether_header peek;
+	struct se_classstats *cs;
 	register struct mbuf *m;
-	struct ifqueue *inq;
+	struct mbuf *n;
 	register unsigned short type;
-	unsigned short next, tail;
-	int s;
+	unsigned short next;
+	int len, s;
+
+	len = se_rxhdr(ctx, taken, &next);
+	if (len < 0) {
+		return 0;
+	}
+
+	/* Look at the ethernet header while it's still in the ring, and if
+	 * nobody is going to take the frame, skip over it without allocating
+	 * or copying anything. (The space is handed back to the chip along
+	 * with the rest of the batch by se_rxdrain().) */
+	se_peekbytes(ctx, (unsigned char *)&peek, sizeof(peek));
 
 	ifp->if_ipackets++;
+	ctx->stats.ss_ibytes += len;
+	cs = &ctx->stats.ss_class[SE_CLASS(peek.ether_type)];
+	cs->cs_ipackets++;
+	cs->cs_ibytes += len;
+	SE_TRACE(ctx, SE_TR_RXPKT, SE_CLASS(peek.ether_type), ctx->rxptr, next);
+
+#ifdef ETHERLINK
+	/* While capturing, offer every frame to the filter first. Then, since
+	 * the chip is taking everything on the wire, drop frames that weren't
+	 * meant for us before they go anywhere else. */
+	if (ctx->filter.sf_len) {
+		se_capture(ctx, len);
+		if (!(peek.ether_dhost[0] & 1) &&
+		    bcmp((caddr_t)peek.ether_dhost, (caddr_t)ictx->ac.ac_enaddr,
+			 sizeof(peek.ether_dhost))) {
+			SE_TRACE(ctx, SE_TR_RXDROP, SE_TRD_NOTME, ctx->rxptr,
+				 len);
+			ctx->rxptr = next;
+			ctx->stats.ss_notme++;
+			cs->cs_idrops++;
+			return 1;
+		}
+	}
+#endif
 
-	/* se_get returns an mbuf chain with the ethernet header in an mbuf on
-	 * its own, followed by the ethernet payload in subsequent mbufs. The
-	 * header mbuf is pre-offset so that the interface pointer may be
-	 * prepended to it. This structure facilitates the inclusion (for
-	 * AppleTalk) or stripping (for TCP/IP) of the ethernet header while
-	 * keeping the payload aligned to the start of an mbuf (which NFS seems
-	 * to expect). */
-	m = se_get(ctx);
+	if (!se_rxwanted(peek.ether_type)) {
+		SE_TRACE(ctx, SE_TR_RXDROP, SE_TRD_UNWANTED, ctx->rxptr, len);
+		ctx->rxptr = next;
+		ctx->stats.ss_unwanted++;
+		cs->cs_idrops++;
+		return 1;
+	}
+
+	/* Likewise multicasts that only got past the chip's hash filter
+	 * because their address hashes the same as one we want */
+	if ((peek.ether_dhost[0] & 1) && !ictx->nmcover &&
+	    !SE_ISBCAST(peek.ether_dhost) &&
+	    !se_find_multi(ictx->mcast, ictx->nmcast,
+			   (unsigned short *)peek.ether_dhost)) {
+		SE_TRACE(ctx, SE_TR_RXDROP, SE_TRD_MCAST, ctx->rxptr, len);
+		ctx->rxptr = next;
+		ctx->stats.ss_mcastmiss++;
+		cs->cs_idrops++;
+		return 1;
+	}
+
+	/* se_get returns the whole frame in a single mbuf or cluster (unless
+	 * it is bigger than a cluster), offset so that the interface pointer
+	 * may be prepended to it, and so that the payload is longword-aligned
+	 * (which NFS seems to expect). The ethernet header can then be
+	 * included (for AppleTalk) or stripped (for TCP/IP) just by adjusting
+	 * the offset. */
+	m = se_get(ctx, len);
 	if (m == 0) {
-		printf("se%d: Packet read failed.\n", ifp->if_unit);
-		goto done;
+		SE_TRACE(ctx, SE_TR_RXDROP, SE_TRD_NOMBUF, ctx->rxptr, len);
+		ctx->rxptr = next;
+		DBGP(("se%d: Packet read failed.\n", ifp->if_unit));
+		ctx->stats.ss_nombuf++;
+		cs->cs_idrops++;
+		return 1;
+	}
+	ctx->rxptr = next;
+	for (n = m; n; n = n->m_next) {
+		cs->cs_imbufs++;
 	}
 
 	eh = mtod(m, struct ether_header *);
@@ -616,36 +1612,46 @@ struct se_context *ctx;
 
 	switch (type) {
 	case ETHERTYPE_IP:
-		schednetisr(NETISR_IP);
-		inq = &ipintrq;
-		goto enqueue;
+		IF_ENQUEUE(&b->ipq, m);
+		break;
 
 	case ETHERTYPE_ARP:
-		arpinput(&ctx->ac, m);
-		goto done;
+		s = splimp();
+		arpinput(&ictx->ac, m);
+		splx(s);
+		break;
 
 	case ETHERTYPE_REVARP:
-		revarpinput(&ctx->ac, m);
-		goto done;
+		s = splimp();
+		revarpinput(&ictx->ac, m);
+		splx(s);
+		break;
 	default:
 #ifdef APPLETALK
 		if (type <= ETHERMTU && NETISR_ET != NULL) {
 			if (type < 60) {
-				/* Discard padding for short packets */
-				m->m_next->m_len = type;
+				/* Discard padding for short packets (which
+				 * always fit in a single mbuf) */
+				m->m_len = sizeof(struct ifnet *) +
+					   sizeof(struct ether_header) + type;
 			}
 
 			/* ugh. Appletalk expects the 8-byte LLC header to be
-			 * contiguous with the ethernet header. */
-			m = m_pullup(m, sizeof(struct ifnet *)
-				     + sizeof(struct ether_header) + 8);
-
-			schednetisr(*NETISR_ET);
-			inq = &etintrq;
-			goto enqueue;
-		} else if (NETISR_ET = NULL) {
+			 * contiguous with the ethernet header. It normally
+			 * will be already. */
+			if (m->m_len < (int)(sizeof(struct ifnet *) +
+					     sizeof(struct ether_header) + 8)) {
+				m = m_pullup(m, sizeof(struct ifnet *) +
+					     sizeof(struct ether_header) + 8);
+			}
+			if (m) {
+				IF_ENQUEUE(&b->etq, m);
+			}
+			break;
+		} else if (type <= ETHERMTU) {
+			/* 802.3 packet, but AppleTalk isn't running */
 			m_freem(m);
-			goto done;
+			break;
 		}
 #endif
 #ifdef ETHERLINK
@@ -659,46 +1665,278 @@ struct se_context *ctx;
 		      (unsigned char *)redst.sa_data,
 		      sizeof(eh->ether_dhost));
 
-		/* raw_input takes the payload only, no interface ptr */
-		raw_input(m->m_next, &reproto, &resrc, &redst);
-		m_free(m);
-		goto done;
+		/* raw_input takes the payload only, no interface ptr or
+		 * ethernet header */
+		m_adj(m, sizeof(struct ifnet *) +
+			 (type <= ETHERMTU ? sizeof(struct ether_header) : 0));
+		s = splimp();
+		raw_input(m, &reproto, &resrc, &redst);
+		splx(s);
 #else
 		m_freem(m);
-		goto done;
 #endif
+		break;
 	}
-enqueue:
-	s = splimp();
-	if (IF_QFULL(inq)) {
-		IF_DROP(inq);
-		splx(s);
-		m_freem(m);
-		return;
+	return 1;
+}
+
+/* Decide whether anyone will take a received frame of the given ethernet type
+ * (or 802.3 length). This has to agree with the switch in se_rpkt(). */
+INTERNAL int se_rxwanted(type)
+unsigned short type;
+{
+#ifdef ETHERLINK
+	register unsigned short h;
+#endif
+
+	switch (type) {
+	case ETHERTYPE_IP:
+	case ETHERTYPE_ARP:
+	case ETHERTYPE_REVARP:
+		return 1;
 	}
-	IF_ENQUEUE(inq, m);
-	splx(s);
-done:
-	return;
+#ifdef APPLETALK
+	if (type <= ETHERMTU) {
+		return NETISR_ET != NULL;
+	}
+#endif
+#ifdef ETHERLINK
+	/* Is there an ETHERLINK raw socket bound to this type (or to all
+	 * types)? The socket list itself can be in the middle of changing
+	 * when we're called, so go by se_rawtypes. */
+	h = SE_RAWHASH(type);
+	if (se_rawtypes[h >> 3] & (1 << (h & 7))) {
+		return 1;
+	}
+#endif
+	return 0;
 }
 
-/* ioctl handler */
-INTERNAL int se_ioctl(ifp, cmd, data)
-struct ifnet *ifp;
-int cmd;
-unsigned char * data;
+#ifdef ETHERLINK
+/* Run the capture filter over the len-byte frame at the read pointer, and if
+ * it is accepted, copy as much of it as the filter asks for (up to the snap
+ * length) and pass it to raw sockets bound to SE_CAPTURE_TYPE. The filter only
+ * looks at the first SE_FPEEK bytes, so a rejected frame costs one short read
+ * from the card rather than an mbuf and a copy of the whole thing. The read
+ * pointer is left where it was. */
+INTERNAL void se_capture(ctx, len)
+struct se_context *ctx;
+int len;
 {
-	struct ifaddr *ifa = (struct ifaddr *)data;
-	struct sockaddr *sa = (struct sockaddr *)data;
-	struct se_context *ctx = &se[ifp->if_unit];
-	int s = splimp();
-	int error = 0;
-	int bit;
+	unsigned char buf[SE_FPEEK];
+	register struct mbuf *m;
+	register unsigned long snap;
+	unsigned short rxptr;
+	int s;
 
-	DBGP(("se%d: ioctl %x from pid %d\n",
+	rxptr = ctx->rxptr;
+	se_peekbytes(ctx, buf, MIN(len, SE_FPEEK));
+	snap = se_fexec(ctx->filter.sf_prog, buf, MIN(len, SE_FPEEK), len);
+	if (snap == 0) {
+		return;
+	}
+	snap = MIN(snap, (unsigned long)ctx->filter.sf_snaplen);
+	snap = MIN(snap, (unsigned long)len);
+	snap = MAX(snap, sizeof(struct ether_header));
+
+	m = se_get(ctx, (int)snap);
+	ctx->rxptr = rxptr;
+	if (m == 0) {
+		ctx->stats.ss_nombuf++;
+		return;
+	}
+	ctx->stats.ss_captured++;
+	ctx->stats.ss_capbytes += snap;
+
+	/* Addresses as for any other raw frame, but the data is the whole
+	 * frame */
+	reproto.sp_protocol = SE_CAPTURE_TYPE;
+	bcopy(mtod(m, caddr_t), (caddr_t)resrc.sa_data,
+	      sizeof(struct ether_header));
+	bcopy(mtod(m, caddr_t), (caddr_t)redst.sa_data,
+	      sizeof(((struct ether_header *)0)->ether_dhost));
+	s = splimp();
+	raw_input(m, &reproto, &resrc, &redst);
+	splx(s);
+}
+
+/* Run a capture filter program over the first buflen bytes of a frame that is
+ * wirelen bytes long. Returns the number of bytes of the frame to capture, or
+ * 0 to reject it. se_set_filter() has already checked that every jump lands
+ * inside the program and that it ends with SE_F_RET, and that no load offset
+ * is beyond SE_FPEEK, so the only checks needed here are against the end of
+ * the frame. */
+INTERNAL unsigned long se_fexec(pc, p, buflen, wirelen)
+register struct se_finsn *pc;
+register unsigned char *p;
+int buflen;
+int wirelen;
+{
+	register unsigned long a = 0, x = 0;
+	register unsigned long k, end = buflen;
+
+	for (;; pc++) {
+		k = pc->fi_k;
+		switch (pc->fi_code) {
+		case SE_F_RET:
+			return k;
+		case SE_F_LDBX:
+			k += x;
+			/* fall through */
+		case SE_F_LDB:
+			if (k + 1 > end) {
+				return 0;
+			}
+			a = p[k];
+			break;
+		case SE_F_LDHX:
+			k += x;
+			/* fall through */
+		case SE_F_LDH:
+			if (k + 2 > end) {
+				return 0;
+			}
+			a = (p[k] << 8) | p[k + 1];
+			break;
+		case SE_F_LDW:
+			if (k + 4 > end) {
+				return 0;
+			}
+			a = ((unsigned long)p[k] << 24) | (p[k + 1] << 16) |
+			    (p[k + 2] << 8) | p[k + 3];
+			break;
+		case SE_F_LDXHL:
+			if (k + 1 > end) {
+				return 0;
+			}
+			x = (p[k] & 0xf) << 2;
+			break;
+		case SE_F_LEN:
+			a = wirelen;
+			break;
+		case SE_F_AND:
+			a &= k;
+			break;
+		case SE_F_JEQ:
+			pc += (a == k) ? pc->fi_jt : pc->fi_jf;
+			break;
+		case SE_F_JGT:
+			pc += (a > k) ? pc->fi_jt : pc->fi_jf;
+			break;
+		case SE_F_JSET:
+			pc += (a & k) ? pc->fi_jt : pc->fi_jf;
+			break;
+		default:
+			return 0;
+		}
+	}
+}
+#endif /* ETHERLINK */
+
+/* Queue a batch of received packets for their protocols, and schedule the
+ * protocols' software interrupts */
+INTERNAL void se_rxflush(ctx, b)
+struct se_context *ctx;
+struct se_rxbatch *b;
+{
+	int s;
+
+	s = splimp();
+	if (b->ipq.ifq_head) {
+		ctx->stats.ss_iqdrops += se_rxenqueue(&ipintrq, &b->ipq);
+		schednetisr(NETISR_IP);
+	}
+#ifdef APPLETALK
+	if (b->etq.ifq_head) {
+		ctx->stats.ss_iqdrops += se_rxenqueue(&etintrq, &b->etq);
+		schednetisr(*NETISR_ET);
+	}
+	SE_TRACE(ctx, SE_TR_RXFLUSH, 0, ipintrq.ifq_len, etintrq.ifq_len);
+#else
+	SE_TRACE(ctx, SE_TR_RXFLUSH, 0, ipintrq.ifq_len, 0);
+#endif
+	splx(s);
+}
+
+/* Move the packets in batch queue bq onto protocol input queue inq, dropping
+ * any that don't fit. Returns the number dropped. Must be called at
+ * splimp(). */
+INTERNAL int se_rxenqueue(inq, bq)
+struct ifqueue *inq;
+struct ifqueue *bq;
+{
+	struct mbuf *m;
+	int dropped = 0;
+
+	for (;;) {
+		IF_DEQUEUE(bq, m);
+		if (m == 0) {
+			break;
+		}
+		if (IF_QFULL(inq)) {
+			IF_DROP(inq);
+			m_freem(m);
+			dropped++;
+		} else {
+			IF_ENQUEUE(inq, m);
+		}
+	}
+	return dropped;
+}
+
+/* ioctl handler */
+INTERNAL int se_ioctl(ifp, cmd, data)
+struct ifnet *ifp;
+int cmd;
+unsigned char * data;
+{
+	struct ifaddr *ifa = (struct ifaddr *)data;
+	struct sockaddr *sa = (struct sockaddr *)data;
+	struct se_context *ctx = &se[ifp->if_unit];
+	int s;
+	int error = 0;
+
+	DBGP(("se%d: ioctl %x from pid %d\n",
 		ifp->if_unit, cmd, u.u_procp->p_pid));
+
+	/* Driver-private ioctls copy data in and out of user space, so handle
+	 * them before raising the priority level */
+	switch (cmd) {
+	case SIOCSSEPARAM:
+	case SIOCGSEPARAM:
+	case SIOCSSEPMATCH:
+	case SIOCGSEPMATCH:
+	case SIOCGSESTATS:
+	case SIOCZSESTATS:
+	case SIOCGSETRACE:
+	case SIOCZSETRACE:
+	case SIOCGSERXWM:
+	case SIOCZSERXWM:
+	case SIOCSSEBOND:
+	case SIOCGSEBOND:
+#ifdef ETHERLINK
+	case SIOCSSEFILTER:
+	case SIOCGSEFILTER:
+#endif
+#ifdef ENC624J600_REGTRACE
+	case SIOCGSEREGTRACE:
+	case SIOCZSEREGTRACE:
+#endif
+#ifdef SE_PROFILE
+	case SIOCGSEPROF:
+	case SIOCZSEPROF:
+#endif
+		return se_privioctl(ctx, cmd, (struct ifreq *)data);
+	}
+
+	s = splimp();
 	switch (cmd) {
 	case SIOCSIFADDR:
+		if (SE_IFCTX(ctx) != ctx) {
+			/* The bond's address belongs to the master */
+			error = EBUSY;
+			break;
+		}
 		ifp->if_flags |= IFF_UP;
 		switch (ifa->ifa_addr.sa_family) {
 		case AF_INET:
@@ -740,36 +1978,38 @@ unsigned char * data;
 #ifdef APPLETALK
 	case SIOCSMAR:
 		/* Subscribe to a multicast address */
-		bit = se_multicast_hash(sa->sa_data);
-		ctx->mcast_refcount[bit]++;
-		se_update_multicast(ctx);
+		error = se_add_multi(ctx, (unsigned char *)sa->sa_data);
+		if (!error) {
+			se_update_multicast(ctx);
+		}
 		break;
 	case SIOCUMAR:
 		/* Unsubscribe from a multicast address */
-		bit = se_multicast_hash(sa->sa_data);
-		if (ctx->mcast_refcount[bit] > 0) {
-			ctx->mcast_refcount[bit]--;
+		error = se_del_multi(ctx, (unsigned char *)sa->sa_data);
+		if (!error) {
 			se_update_multicast(ctx);
 		}
 		break;
 	case SIOCGMAR:
-		/* This ioctl appears to just dump the multicast hash table as
-		 * stored in the ethernet controller's registers. The ENC624J600
-		 * hashes addresses differently to the DP8390 so this probably
-		 * won't work as it's supposed to :/ */
+		/* Return the multicast filter as a DP8390 would have it: a
+		 * 64-bit table indexed by the top six bits of the CRC of each
+		 * address. The chip's own hash uses different bits, so build
+		 * it from the lists of addresses. */
 		DBGP(("se%d: pid %d dumped the multicast table.\n",
 		      ifp->if_unit, u.u_procp->p_pid));
 		{
 			int i;
-			unsigned short *words;
-			words = (unsigned short *)sa->sa_data;
-			words[0] = ENC624J600_READ_REG(ctx->base_address, EHT1);
-			words[1] = ENC624J600_READ_REG(ctx->base_address, EHT2);
-			words[2] = ENC624J600_READ_REG(ctx->base_address, EHT3);
-			words[3] = ENC624J600_READ_REG(ctx->base_address, EHT4);
-
-			for (i = 0; i < 4; i++) {
-				words[i] = SWAPBYTES(words[i]);
+			unsigned long bit;
+			struct se_mcast *mc;
+
+			bzero(sa->sa_data, 8);
+			for (i = 0; i < ctx->nmcast + ctx->nmcover; i++) {
+				mc = i < ctx->nmcast ? &ctx->mcast[i] :
+					&ctx->mcover[i - ctx->nmcast];
+				bit = se_multicast_crc((unsigned char *)
+						       mc->addr);
+				bit >>= 26;
+				sa->sa_data[bit >> 3] |= 1 << (bit & 7);
 			}
 		}
 		break;
@@ -784,121 +2024,1055 @@ unsigned char * data;
 	return error;
 }
 
-/* Read autonegotiated full/half-duplex status from PHY, set MAC duplex and
- * back-to-back interpacket gap as appropriate. Call on initial startup and
- * whenever link stage changes. */
-INTERNAL void se_update_linkstate(ctx)
+/* Handler for driver-private ioctls */
+INTERNAL int se_privioctl(ctx, cmd, ifr)
+struct se_context *ctx;
+int cmd;
+struct ifreq *ifr;
+{
+	struct se_param param;
+	struct se_pmatch pm;
+	struct se_stats st;
+	struct se_rxwm wm;
+	struct se_bond bond;
+	struct se_context *mctx;
+#ifdef ETHERLINK
+	struct se_filter filt;
+#endif
+	int error = 0;
+	int i, s;
+
+	switch (cmd) {
+	case SIOCSSEPARAM:
+		if (!suser()) {
+			return EPERM;
+		}
+		if (copyin(ifr->ifr_data, (caddr_t)&param, sizeof(param))) {
+			return EFAULT;
+		}
+		error = se_setparam(ctx, param.sp_param, param.sp_value);
+		break;
+	case SIOCGSEPARAM:
+		if (copyin(ifr->ifr_data, (caddr_t)&param, sizeof(param))) {
+			return EFAULT;
+		}
+		error = se_getparam(ctx, param.sp_param, &param.sp_value);
+		if (!error && copyout((caddr_t)&param, ifr->ifr_data,
+				      sizeof(param))) {
+			error = EFAULT;
+		}
+		break;
+	case SIOCSSEPMATCH:
+		if (!suser()) {
+			return EPERM;
+		}
+		if (copyin(ifr->ifr_data, (caddr_t)&pm, sizeof(pm))) {
+			return EFAULT;
+		}
+		s = splimp();
+		error = se_set_pmatch(ctx, &pm);
+		splx(s);
+		break;
+	case SIOCGSEPMATCH:
+		if (copyout((caddr_t)&ctx->pmatch, ifr->ifr_data,
+			    sizeof(ctx->pmatch))) {
+			error = EFAULT;
+		}
+		break;
+	case SIOCZSESTATS:
+		if (!suser()) {
+			return EPERM;
+		}
+		/* fall through */
+	case SIOCGSESTATS:
+		/* Take a consistent snapshot (and zero the counters in the
+		 * same breath, so nothing is lost between reading and
+		 * zeroing) */
+		s = splimp();
+		se_getstats(ctx, &st);
+		if (cmd == SIOCZSESTATS) {
+			se_zerostats(ctx);
+		}
+		splx(s);
+		if (copyout((caddr_t)&st, ifr->ifr_data, sizeof(st))) {
+			error = EFAULT;
+		}
+		break;
+	case SIOCZSETRACE:
+		if (!suser()) {
+			return EPERM;
+		}
+		/* fall through */
+	case SIOCGSETRACE:
+		/* Copied out directly, like the profiling counters. setrace
+		 * copes with events being added while we do this. */
+		if (copyout((caddr_t)&ctx->trace, ifr->ifr_data,
+			    sizeof(ctx->trace))) {
+			error = EFAULT;
+		} else if (cmd == SIOCZSETRACE) {
+			s = splimp();
+			ctx->trace.st_next = 0;
+			splx(s);
+		}
+		break;
+	case SIOCSSEBOND:
+		if (!suser()) {
+			return EPERM;
+		}
+		if (copyin(ifr->ifr_data, (caddr_t)&bond, sizeof(bond))) {
+			return EFAULT;
+		}
+		s = splimp();
+		error = se_setbond(ctx, bond.sb_members);
+		splx(s);
+		break;
+	case SIOCGSEBOND:
+		mctx = SE_IFCTX(ctx);
+		bond.sb_master = mctx->ac.ac_if.if_unit;
+		bond.sb_members = mctx->bondmask ? mctx->bondmask :
+						   1 << bond.sb_master;
+		bond.sb_active = 0;
+		for (i = 0; i < N_SE; i++) {
+			if ((bond.sb_members & (1 << i)) && se[i].linkup) {
+				bond.sb_active |= 1 << i;
+			}
+		}
+		if (copyout((caddr_t)&bond, ifr->ifr_data, sizeof(bond))) {
+			error = EFAULT;
+		}
+		break;
+#ifdef ETHERLINK
+	case SIOCSSEFILTER:
+		if (!suser()) {
+			return EPERM;
+		}
+		if (copyin(ifr->ifr_data, (caddr_t)&filt, sizeof(filt))) {
+			return EFAULT;
+		}
+		s = splimp();
+		error = se_set_filter(ctx, &filt);
+		splx(s);
+		break;
+	case SIOCGSEFILTER:
+		if (copyout((caddr_t)&ctx->filter, ifr->ifr_data,
+			    sizeof(ctx->filter))) {
+			error = EFAULT;
+		}
+		break;
+#endif
+	case SIOCZSERXWM:
+		if (!suser()) {
+			return EPERM;
+		}
+		/* fall through */
+	case SIOCGSERXWM:
+		s = splimp();
+		wm = ctx->rxwm;
+		if (cmd == SIOCZSERXWM) {
+			ctx->rxwm.rw_samples = 0;
+			ctx->rxwm.rw_raises = 0;
+			ctx->rxwm.rw_lowers = 0;
+			bzero((caddr_t)ctx->rxwm.rw_hist,
+			      sizeof(ctx->rxwm.rw_hist));
+		}
+		splx(s);
+		if (copyout((caddr_t)&wm, ifr->ifr_data, sizeof(wm))) {
+			error = EFAULT;
+		}
+		break;
+#ifdef ENC624J600_REGTRACE
+	case SIOCZSEREGTRACE:
+		if (!suser()) {
+			return EPERM;
+		}
+		/* fall through */
+	case SIOCGSEREGTRACE:
+		/* copyout() touches no registers, so doesn't add to the log */
+		if (copyout((caddr_t)&se_regtrace, ifr->ifr_data,
+			    sizeof(se_regtrace))) {
+			error = EFAULT;
+		} else if (cmd == SIOCZSEREGTRACE) {
+			s = splimp();
+			se_regtrace.rt_next = 0;
+			splx(s);
+		}
+		break;
+#endif
+#ifdef SE_PROFILE
+	case SIOCZSEPROF:
+		if (!suser()) {
+			return EPERM;
+		}
+		/* fall through */
+	case SIOCGSEPROF:
+		/* The counters are too big to snapshot on the stack, so copy
+		 * them out directly. They may change under our feet, but
+		 * we're only after a rough picture. */
+		if (copyout((caddr_t)&ctx->prof, ifr->ifr_data,
+			    sizeof(ctx->prof))) {
+			error = EFAULT;
+		} else if (cmd == SIOCZSEPROF) {
+			s = splimp();
+			bzero((caddr_t)&ctx->prof, sizeof(ctx->prof));
+			splx(s);
+		}
+		break;
+#endif
+	default:
+		error = EINVAL;
+		break;
+	}
+	return error;
+}
+
+/* Fill in a snapshot of the statistics. Must be called at splimp(). */
+INTERNAL void se_getstats(ctx, st)
+struct se_context *ctx;
+struct se_stats *st;
+{
+	struct ifnet *ifp = &ctx->ac.ac_if;
+
+	*st = ctx->stats;
+	st->ss_ipackets = ifp->if_ipackets;
+	st->ss_ierrors = ifp->if_ierrors;
+	st->ss_opackets = ifp->if_opackets;
+	st->ss_oerrors = ifp->if_oerrors;
+	st->ss_collisions = ifp->if_collisions;
+	st->ss_oqdrops = ifp->if_snd.ifq_drops;
+	st->ss_poollow[SE_POOL_SMALL] = ctx->rxpool[SE_POOL_SMALL].lowest;
+	st->ss_poollow[SE_POOL_CLUST] = ctx->rxpool[SE_POOL_CLUST].lowest;
+}
+
+/* Zero the driver's own statistics. Must be called at splimp(). */
+INTERNAL void se_zerostats(ctx)
+struct se_context *ctx;
+{
+	bzero((caddr_t)&ctx->stats, sizeof(ctx->stats));
+	ctx->rxpool[SE_POOL_SMALL].lowest = ctx->rxpool[SE_POOL_SMALL].count;
+	ctx->rxpool[SE_POOL_CLUST].lowest = ctx->rxpool[SE_POOL_CLUST].count;
+}
+
+/* Set a driver parameter (SIOCSSEPARAM) */
+INTERNAL int se_setparam(ctx, param, value)
+struct se_context *ctx;
+int param;
+int value;
+{
+	int s;
+
+	switch (param) {
+	case SE_PARAM_TXSLOTS:
+		return se_set_txslots(ctx, value);
+	case SE_PARAM_TXCSUM:
+		ctx->txcsum = (value != 0);
+		return 0;
+	case SE_PARAM_RXBUDGET:
+		if (value < 0 || value > 255) {
+			return EINVAL;
+		}
+		ctx->rxbudget = value;
+		return 0;
+	case SE_PARAM_RXPOLL:
+		if (value < 1 || value > HZ) {
+			return EINVAL;
+		}
+		ctx->rxpollticks = value;
+		return 0;
+	case SE_PARAM_SOFTRX:
+		ctx->softrx = (value != 0);
+		return 0;
+	case SE_PARAM_TRACE:
+		ctx->tracing = (value != 0);
+		return 0;
+	case SE_PARAM_TXLAZY:
+		s = splimp();
+		ctx->txlazy = (value != 0);
+		se_txintr(ctx);
+		splx(s);
+		return 0;
+	case SE_PARAM_WMTUNE:
+		s = splimp();
+		ctx->wmtune = (value != 0);
+		se_rxwm_init(ctx);
+		splx(s);
+		return 0;
+	case SE_PARAM_RXPOOL:
+		if (value < 0 || value > SE_MAXRXPOOL) {
+			return EINVAL;
+		}
+		ctx->rxpoolsize = value;
+		se_rxpool_fill(ctx);
+		return 0;
+	default:
+		return EINVAL;
+	}
+}
+
+/* Get a driver parameter (SIOCGSEPARAM) */
+INTERNAL int se_getparam(ctx, param, value)
+struct se_context *ctx;
+int param;
+int *value;
+{
+	switch (param) {
+	case SE_PARAM_TXSLOTS:
+		*value = ctx->ntxslots;
+		break;
+	case SE_PARAM_TXCSUM:
+		*value = ctx->txcsum;
+		break;
+	case SE_PARAM_RXBUDGET:
+		*value = ctx->rxbudget;
+		break;
+	case SE_PARAM_RXPOLL:
+		*value = ctx->rxpollticks;
+		break;
+	case SE_PARAM_SOFTRX:
+		*value = ctx->softrx;
+		break;
+	case SE_PARAM_RXPOOL:
+		*value = ctx->rxpoolsize;
+		break;
+	case SE_PARAM_TRACE:
+		*value = ctx->tracing;
+		break;
+	case SE_PARAM_TXLAZY:
+		*value = ctx->txlazy;
+		break;
+	case SE_PARAM_WMTUNE:
+		*value = ctx->wmtune;
+		break;
+	default:
+		return EINVAL;
+	}
+	return 0;
+}
+
+/* Note that the link state has changed (or needs syncing at startup). The MAC
+ * can't safely be reconfigured while it is transmitting or sending pause
+ * frames, so se_linkpoll() does it from a timeout once both have stopped, and
+ * se_start() holds back new frames meanwhile. Further changes before then are
+ * folded into the same reconfiguration. Must be called at splimp(). */
+INTERNAL void se_linkchange(ctx)
+struct se_context *ctx;
+{
+	if (!ctx->linkpend) {
+		ctx->linkpend = 1;
+		ctx->linkwait = 0;
+		timeout(se_linkpoll, ctx, 1);
+	}
+}
+
+/* Called by timeout() while a link change is pending. Once the frames already
+ * staged have gone and flow control is idle (or we've waited SE_LINKWAIT ticks
+ * for that), reconfigure the MAC and let transmission carry on. */
+INTERNAL void se_linkpoll(p)
+void *p;
+{
+	struct se_context *ctx = (struct se_context *)p;
+	int unit = ctx->ac.ac_if.if_unit;
+	unsigned short estat;
+	int s;
+
+	s = splimp();
+	estat = ENC624J600_READ_REG(ctx->base_address, ESTAT);
+	if (ctx->txcount > 0 || !(estat & ESTAT_FCIDLE)) {
+		if (++ctx->linkwait < SE_LINKWAIT) {
+			timeout(se_linkpoll, ctx, 1);
+			splx(s);
+			return;
+		}
+		printf("se%d: transmitter not idle, reconfiguring link "
+		       "anyway\n", unit);
+	}
+
+	se_update_linkstate(ctx);
+	ctx->linkpend = 0;
+	ctx->linkup = (estat & ESTAT_PHYLNK) != 0;
+	if (!ctx->linkup && ctx->bondmaster) {
+		se_bondfailover(ctx);
+	}
+	if (estat & ESTAT_PHYLNK) {
+		printf("se%d: link up, %s duplex\n", unit,
+		       (estat & ESTAT_PHYDPX) ? "full" : "half");
+	} else {
+		printf("se%d: link down\n", unit);
+	}
+
+	if (ctx->ac.ac_if.if_snd.ifq_head) {
+		se_start(unit);
+	}
+	se_txintr(ctx);
+	splx(s);
+}
+
+/* Read autonegotiated full/half-duplex status from PHY, set MAC duplex and
+ * back-to-back interpacket gap as appropriate. Flow control must be idle; see
+ * se_linkchange(). */
+INTERNAL void se_update_linkstate(ctx)
+struct se_context *ctx;
+{
+	if (ENC624J600_READ_REG(ctx->base_address, ESTAT) & ESTAT_PHYDPX) {
+		/* Full duplex */
+		ENC624J600_SET_BITS(ctx->base_address, MACON2, MACON2_FULDPX);
+		ENC624J600_WRITE_REG(ctx->base_address, MABBIPG,
+				     0x15 << MABBIPG_BBIPG_SHIFT);
+		/* Enable automtaic flow control */
+		ENC624J600_SET_BITS(ctx->base_address, ECON2, ECON2_AUTOFC);
+	} else {
+		/* Half duplex */
+		ENC624J600_CLEAR_BITS(ctx->base_address, MACON2, MACON2_FULDPX);
+		ENC624J600_WRITE_REG(ctx->base_address, MABBIPG,
+				     0x12 << MABBIPG_BBIPG_SHIFT);
+		/* Disable automatic flow control */
+		ENC624J600_CLEAR_BITS(ctx->base_address, ECON2, ECON2_AUTOFC);
+		/* Ensure flow control is deasserted */
+		ENC624J600_CLEAR_BITS(ctx->base_address, ECON1,
+				      ECON1_FCOP1 | ECON1_FCOP0);
+	}
+}
+
+/* Update the ENC624J600 multicast hash table from our reference-count array */
+INTERNAL void se_update_multicast(ctx)
+struct se_context *ctx;
+{
+	struct se_context *ictx = SE_IFCTX(ctx);
+	unsigned short reg;
+	unsigned short bit;
+	unsigned short table[4];
+	int i;
+
+	/* Build multicast hash table bits. The members of a bond share the
+	 * master's subscriptions. */
+	for (reg = 0; reg < 4; reg++) {
+		table[reg] = 0;
+		for (bit = 0; bit < 16; bit++) {
+			if (ictx->mcast_refcount[(reg * 16) + bit]) {
+				table[reg] |= BIT(bit);
+			}
+		}
+	}
+
+	ENC624J600_WRITE_REG(ctx->base_address, EHT1, SWAPBYTES(table[0]));
+	ENC624J600_WRITE_REG(ctx->base_address, EHT2, SWAPBYTES(table[1]));
+	ENC624J600_WRITE_REG(ctx->base_address, EHT3, SWAPBYTES(table[2]));
+	ENC624J600_WRITE_REG(ctx->base_address, EHT4, SWAPBYTES(table[3]));
+
+	/* If we're the master of a bond, bring the others into line */
+	for (i = 0; i < N_SE; i++) {
+		if ((ctx->bondmask & (1 << i)) && &se[i] != ctx) {
+			se_update_multicast(&se[i]);
+		}
+	}
+}
+
+/* Program the chip's receive filters from the driver's state. We always reject
+ * bad-CRC and runt frames and accept unicast-to-us. Broadcasts and multicast
+ * hash matches are accepted, unless the pattern-match filter is on, in which
+ * case it takes over collecting the broadcasts (and multicasts) that match.
+ * While a capture filter is installed, everything is accepted, and se_rpkt()
+ * sorts it out. */
+INTERNAL void se_update_rxfilter(ctx)
+struct se_context *ctx;
+{
+	register struct se_pmatch *pm = &ctx->pmatch;
+	unsigned short fcon;
+	unsigned short *mask;
+
+	fcon = ERXFCON_CRCEN | ERXFCON_RUNTEN | ERXFCON_UCEN;
+	if (ctx->filter.sf_len) {
+		fcon |= ERXFCON_NOTMEEN | ERXFCON_MCEN | ERXFCON_BCEN;
+		ENC624J600_WRITE_REG(ctx->base_address, ERXFCON, fcon);
+		return;
+	}
+	switch (pm->pm_mode) {
+	case SE_PM_BCAST:
+		/* pattern match, destination is broadcast */
+		fcon |= ERXFCON_HTEN | (0x4 << ERXFCON_PMEN_SHIFT);
+		break;
+	case SE_PM_NOTUCAST:
+		/* pattern match, destination is not unicast */
+		fcon |= (0x7 << ERXFCON_PMEN_SHIFT);
+		break;
+	default:
+		fcon |= ERXFCON_BCEN | ERXFCON_HTEN;
+		break;
+	}
+
+	if (pm->pm_mode != SE_PM_OFF) {
+		/* Mask bytes are in the chip's (little-endian) order already,
+		 * so go straight to the bus without swapping them */
+		mask = (unsigned short *)pm->pm_mask;
+		ENC624J600_WRITE_REG(ctx->base_address, EPMM1, mask[0]);
+		ENC624J600_WRITE_REG(ctx->base_address, EPMM2, mask[1]);
+		ENC624J600_WRITE_REG(ctx->base_address, EPMM3, mask[2]);
+		ENC624J600_WRITE_REG(ctx->base_address, EPMM4, mask[3]);
+		ENC624J600_WRITE_REG(ctx->base_address, EPMOL,
+				     SWAPBYTES(pm->pm_offset));
+		ENC624J600_WRITE_REG(ctx->base_address, EPMCS, se_pmcsum(pm));
+	}
+	ENC624J600_WRITE_REG(ctx->base_address, ERXFCON, fcon);
+}
+
+/* Check and install a new pattern-match filter. Must be called at splimp(). */
+INTERNAL int se_set_pmatch(ctx, pm)
+struct se_context *ctx;
+struct se_pmatch *pm;
+{
+	switch (pm->pm_mode) {
+	case SE_PM_OFF:
+		break;
+	case SE_PM_BCAST:
+	case SE_PM_NOTUCAST:
+		if (pm->pm_offset > ETHERMTU + sizeof(struct ether_header) -
+				    sizeof(pm->pm_pattern)) {
+			return EINVAL;
+		}
+		break;
+	default:
+		return EINVAL;
+	}
+	ctx->pmatch = *pm;
+	se_update_rxfilter(ctx);
+	return 0;
+}
+
+#ifdef ETHERLINK
+/* Check and install a new capture filter, or remove it if f->sf_len is 0.
+ * Must be called at splimp(). */
+INTERNAL int se_set_filter(ctx, f)
+struct se_context *ctx;
+struct se_filter *f;
+{
+	register struct se_finsn *fi;
+	int i;
+
+	if (f->sf_len < 0 || f->sf_len > SE_MAXFINSNS) {
+		return EINVAL;
+	}
+	if (f->sf_len) {
+		if (f->sf_snaplen < (int)sizeof(struct ether_header) ||
+		    f->sf_prog[f->sf_len - 1].fi_code != SE_F_RET) {
+			return EINVAL;
+		}
+		if (f->sf_snaplen > ETHERMTU +
+				    (int)sizeof(struct ether_header)) {
+			f->sf_snaplen = ETHERMTU + sizeof(struct ether_header);
+		}
+		for (i = 0; i < f->sf_len; i++) {
+			fi = &f->sf_prog[i];
+			switch (fi->fi_code) {
+			case SE_F_LDB:
+			case SE_F_LDH:
+			case SE_F_LDW:
+			case SE_F_LDBX:
+			case SE_F_LDHX:
+			case SE_F_LDXHL:
+				if (fi->fi_k >= SE_FPEEK) {
+					return EINVAL;
+				}
+				break;
+			case SE_F_JEQ:
+			case SE_F_JGT:
+			case SE_F_JSET:
+				if (i + 1 + fi->fi_jt >= f->sf_len ||
+				    i + 1 + fi->fi_jf >= f->sf_len) {
+					return EINVAL;
+				}
+				break;
+			case SE_F_RET:
+			case SE_F_LEN:
+			case SE_F_AND:
+				break;
+			default:
+				return EINVAL;
+			}
+		}
+	}
+	ctx->filter = *f;
+	se_update_rxfilter(ctx);
+	return 0;
+}
+#endif
+
+/* Calculate the checksum that the chip will compute over the bytes of a
+ * frame selected by a pattern-match filter, if they match. This is the usual
+ * internet checksum, taken over the selected bytes as if they had been packed
+ * together. The result is in network byte order, which is what EPMCS wants
+ * (like EDMACS, it doesn't want swapping). */
+INTERNAL unsigned short se_pmcsum(pm)
+struct se_pmatch *pm;
+{
+	register unsigned long sum = 0;
+	register int i, odd = 0;
+
+	for (i = 0; i < (int)sizeof(pm->pm_pattern); i++) {
+		if (pm->pm_mask[i >> 3] & (1 << (i & 7))) {
+			sum += odd ? pm->pm_pattern[i] : pm->pm_pattern[i] << 8;
+			odd = !odd;
+		}
+	}
+	while (sum >> 16) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+	return ~sum;
+}
+
+/* Add a subscription to a multicast address. Returns ENOSPC if there is no
+ * room left to keep track of it. Must be called at splimp(). */
+INTERNAL int se_add_multi(ctx, addr)
+struct se_context *ctx;
+unsigned char *addr;
+{
+	register struct se_mcast *mc;
+	unsigned short a[3];
+
+	bcopy(addr, (unsigned char *)a, sizeof(a));
+	mc = se_find_multi(ctx->mcast, ctx->nmcast, a);
+	if (mc == 0) {
+		mc = se_find_multi(ctx->mcover, ctx->nmcover, a);
+	}
+	if (mc == 0) {
+		if (ctx->nmcast < SE_MAXMCAST) {
+			mc = &ctx->mcast[ctx->nmcast++];
+		} else if (ctx->nmcover < SE_MAXMCOVER) {
+			/* No room in the exact list, so from now on we
+			 * leave multicasts to the hash filter */
+			mc = &ctx->mcover[ctx->nmcover++];
+		} else {
+			return ENOSPC;
+		}
+		bcopy((unsigned char *)a, (unsigned char *)mc->addr, sizeof(a));
+		mc->refcount = 0;
+	}
+	mc->refcount++;
+	ctx->mcast_refcount[SE_MCAST_HASH(se_multicast_crc(addr))]++;
+	return 0;
+}
+
+/* Remove a subscription to a multicast address. Returns EADDRNOTAVAIL if it
+ * wasn't subscribed. Must be called at splimp(). */
+INTERNAL int se_del_multi(ctx, addr)
+struct se_context *ctx;
+unsigned char *addr;
+{
+	register struct se_mcast *mc;
+	unsigned short a[3];
+
+	bcopy(addr, (unsigned char *)a, sizeof(a));
+	if ((mc = se_find_multi(ctx->mcast, ctx->nmcast, a)) != 0) {
+		if (--mc->refcount == 0) {
+			/* Fill the gap from the overflow list, if there is
+			 * one, so that once it's empty we can filter exactly
+			 * again */
+			if (ctx->nmcover > 0) {
+				*mc = ctx->mcover[--ctx->nmcover];
+			} else {
+				*mc = ctx->mcast[--ctx->nmcast];
+			}
+		}
+	} else if ((mc = se_find_multi(ctx->mcover, ctx->nmcover, a)) != 0) {
+		if (--mc->refcount == 0) {
+			*mc = ctx->mcover[--ctx->nmcover];
+		}
+	} else {
+		return EADDRNOTAVAIL;
+	}
+	ctx->mcast_refcount[SE_MCAST_HASH(se_multicast_crc(addr))]--;
+	return 0;
+}
+
+/* Look up a multicast address in a list of n subscribed addresses. Returns 0
+ * if it isn't there. */
+INTERNAL struct se_mcast * se_find_multi(mc, n, addr)
+register struct se_mcast *mc;
+register int n;
+register unsigned short *addr;
+{
+	for (; n > 0; n--, mc++) {
+		if (mc->addr[0] == addr[0] && mc->addr[1] == addr[1] &&
+		    mc->addr[2] == addr[2]) {
+			return mc;
+		}
+	}
+	return 0;
+}
+
+/* CRC32 (polynomial CRCPOLY) of each possible 4 bits of data, for
+ * se_multicast_crc() */
+INTERNAL unsigned long se_crctab[16] = {
+	0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9,
+	0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005,
+	0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61,
+	0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd
+};
+
+/* Nibbles with their bits reversed. Ethernet sends the least significant bit
+ * of each byte first, and the CRC is taken in that order. */
+INTERNAL unsigned char se_nibrev[16] = {
+	0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+	0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
+};
+
+/* Calculate the ethernet CRC32 of a multicast address, 4 bits at a time. The
+ * chip's hash table is indexed by SE_MCAST_HASH() of this; a DP8390's by the
+ * top six bits. */
+INTERNAL unsigned long se_multicast_crc(addr)
+unsigned char *addr;
+{
+	register unsigned long crc = 0xffffffff;
+	register int i;
+
+	for (i = 0; i < 6; i++) {
+		crc = (crc << 4) ^ se_crctab[(crc >> 28) ^
+					     se_nibrev[addr[i] & 0xf]];
+		crc = (crc << 4) ^ se_crctab[(crc >> 28) ^
+					     se_nibrev[addr[i] >> 4]];
+	}
+	return crc;
+}
+
+/* Write an mbuf chain to the transmit buffer at addr. If hdr is given, an
+ * ethernet header made from it goes in front of the chain; otherwise the chain
+ * must start with one. Returns the length of the frame. */
+INTERNAL int se_put(ctx, addr, hdr, m)
+struct se_context * ctx;
+unsigned short addr;
+struct se_txhdr *hdr;
+struct mbuf *m;
+{
+	register struct mbuf *mp;
+	register int totlen;
+	register unsigned char *bp;
+	register unsigned short *wp;
+
+	bp = ctx->base_address + addr;
+	totlen = 0;
+	if (hdr) {
+		/* Transmit slots are word-aligned, so the header can be
+		 * written a word at a time */
+		wp = (unsigned short *)bp;
+		*wp++ = ((unsigned short *)hdr->dhost)[0];
+		*wp++ = ((unsigned short *)hdr->dhost)[1];
+		*wp++ = ((unsigned short *)hdr->dhost)[2];
+		*wp++ = ((unsigned short *)ctx->ac.ac_enaddr)[0];
+		*wp++ = ((unsigned short *)ctx->ac.ac_enaddr)[1];
+		*wp++ = ((unsigned short *)ctx->ac.ac_enaddr)[2];
+		*wp++ = htons(hdr->type);
+		bp += sizeof(struct ether_header);
+		totlen = sizeof(struct ether_header);
+	}
+	for (mp = m; mp; mp = mp->m_next) {
+		register unsigned mlen = mp->m_len;
+
+		totlen += mlen;
+		if (mlen == 0) {
+			continue;
+		}
+		se_copy(mtod(mp, unsigned char *), bp, mlen);
+		bp += mlen;
+	}
+	m_freem(m);
+	return totlen;
+}
+
+/* Fill in the IP header checksum, and the TCP or UDP checksum, of an outbound
+ * IP packet that has been written to the transmit slot at addr. Only fields
+ * that have been left as zero are computed. The packet headers are read
+ * straight out of buffer memory, which the 68k sees in network byte order. */
+INTERNAL void se_txcsum(ctx, addr, len)
+struct se_context *ctx;
+unsigned short addr;
+int len;
+{
+	register unsigned char *frame = ctx->base_address + addr;
+	register struct ip *ip;
+	unsigned short *sump;
+	unsigned short hlen, iplen, sumoff;
+	unsigned int sum;
+
+	if (((struct ether_header *)frame)->ether_type != ETHERTYPE_IP ||
+	    len < (int)(sizeof(struct ether_header) + sizeof(struct ip))) {
+		return;
+	}
+
+	ip = (struct ip *)(frame + sizeof(struct ether_header));
+	hlen = ip->ip_hl << 2;
+	iplen = ip->ip_len;
+	if (hlen < sizeof(struct ip) || iplen < hlen ||
+	    iplen > len - sizeof(struct ether_header)) {
+		return;
+	}
+
+	/* TCP and UDP checksums cover the whole datagram, so can only be done
+	 * for unfragmented packets */
+	if ((ip->ip_off & (IP_MF | IP_OFFMASK)) == 0) {
+		switch (ip->ip_p) {
+		case IPPROTO_TCP:
+			sumoff = 16;
+			break;
+		case IPPROTO_UDP:
+			sumoff = 6;
+			break;
+		default:
+			sumoff = 0;
+			break;
+		}
+
+		if (sumoff && iplen - hlen >= sumoff + 2) {
+			sump = (unsigned short *)((unsigned char *)ip + hlen +
+						  sumoff);
+			if (*sump == 0) {
+				/* Checksum the pseudo-header in software and
+				 * use it to seed the checksum of the rest */
+				sum = (ip->ip_src.s_addr >> 16) +
+				      (ip->ip_src.s_addr & 0xffff) +
+				      (ip->ip_dst.s_addr >> 16) +
+				      (ip->ip_dst.s_addr & 0xffff) +
+				      ip->ip_p + (iplen - hlen);
+				sum = (sum >> 16) + (sum & 0xffff);
+				sum += sum >> 16;
+
+				sum = se_dmacsum(ctx, addr + hlen +
+						 sizeof(struct ether_header),
+						 iplen - hlen, ~sum & 0xffff);
+
+				/* A UDP checksum of zero means "no checksum",
+				 * so send it as all-ones instead */
+				if (sum == 0 && ip->ip_p == IPPROTO_UDP) {
+					sum = 0xffff;
+				}
+				*sump = htons(sum);
+			}
+		}
+	}
+
+	if (ip->ip_sum == 0) {
+		ip->ip_sum = se_dmacsum(ctx, addr + sizeof(struct ether_header),
+					hlen, 0);
+	}
+}
+
+/* Compute the Internet checksum of len bytes of buffer memory at addr using the
+ * DMA engine. If seed is nonzero, the checksum carries on from it as though it
+ * was the checksum of some preceding data. The result is complemented and in
+ * network byte order, ready to be stored into a header. */
+INTERNAL unsigned short se_dmacsum(ctx, addr, len, seed)
+struct se_context *ctx;
+unsigned short addr;
+unsigned short len;
+unsigned short seed;
+{
+	int spin;
+
+	ENC624J600_WRITE_REG(ctx->base_address, EDMAST, SWAPBYTES(addr));
+	ENC624J600_WRITE_REG(ctx->base_address, EDMALEN, SWAPBYTES(len));
+	if (seed) {
+		/* EDMACS is checksum-ordered data like the packet contents,
+		 * rather than a pointer, so it isn't byte-swapped */
+		ENC624J600_WRITE_REG(ctx->base_address, EDMACS, seed);
+		ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_DMACSSD);
+	} else {
+		ENC624J600_CLEAR_BITS(ctx->base_address, ECON1, ECON1_DMACSSD);
+	}
+
+	/* Checksum only, no copy */
+	ENC624J600_CLEAR_BITS(ctx->base_address, ECON1,
+			      ECON1_DMACPY | ECON1_DMANOCS);
+	ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_DMAST);
+
+	for (spin = 0; ENC624J600_READ_REG(ctx->base_address, ECON1) &
+			       ECON1_DMAST;
+	     spin++) {
+		if (spin > SE_DMA_SPIN) {
+			/* Leave the checksum as zero; the packet will be
+			 * dropped by the receiver, but that beats hanging */
+			printf("se%d: DMA checksum timed out\n",
+			       ctx->ac.ac_if.if_unit);
+			ENC624J600_CLEAR_BITS(ctx->base_address, ECON1,
+					      ECON1_DMAST);
+			return 0;
+		}
+	}
+
+	return ENC624J600_READ_REG(ctx->base_address, EDMACS);
+}
+
+/* Returns nonzero if ifp is an SEthernet interface that will fill in zeroed IP,
+ * TCP and UDP checksums of outbound packets in hardware. Protocol code can use
+ * this to decide whether to skip computing them. */
+int se_txcsum_offload(ifp)
+struct ifnet *ifp;
+{
+	if (ifp->if_output != se_output || ifp->if_unit >= N_SE) {
+		return 0;
+	}
+	return se[ifp->if_unit].txcsum;
+}
+
+/* Called by timeout() at end of se_rxbuf_reset(). Clears reset counter after a
+ * a while so we can differentiate between a one-off error or a card/driver
+ * that's gone haywire */
+INTERNAL void se_reset_counter_clear(p)
+void *p;
+{
+	struct se_context * ctx = (struct se_context *) p;
+	ctx->reset_counter = 0;
+
+	printf("se%d: reset counter cleared\n", ctx->ac.ac_if.if_unit);
+}
+
+/* Program the receive ring boundaries and flow-control watermarks for the
+ * current buffer-memory partition, and rewind our read pointer to the start of
+ * the ring. Reception must be disabled. */
+INTERNAL void se_rxbuf_init(ctx)
+struct se_context *ctx;
+{
+
+	/* Set up receive buffer from end of transmit slots to end of RAM */
+	ENC624J600_WRITE_REG(ctx->base_address, ERXST,
+			     SWAPBYTES(ctx->rxstart));
+	ENC624J600_WRITE_REG(ctx->base_address, ERXTAIL,
+			     SWAPBYTES(SE_RXEND - 2));
+
+	/* Start receive FIFO read pointer at beginning of buffer */
+	ctx->rxptr = ctx->rxstart;
+
+	/* Set up flow control parameters. We only enable flow control for
+	 * full-duplex links, since half-duplex flow control operates by jamming
+	 * the medium, which is an extremely antisocial thing to do on
+	 * shared-media links (such as if connected to a hub rather than a
+	 * switch).
+	 *
+	 * The high- and low-water-mark parameters start out at 3/4 and 1/2
+	 * full, which are completely made up based on gut instinct, and are
+	 * tuned from there by se_rxwm_tune(). */
+	se_rxwm_init(ctx);
+}
+
+/* Set the flow control watermarks for a freshly initialised receive ring. What
+ * tuning has learned is kept across ring resets, unless the ring has changed
+ * size. */
+INTERNAL void se_rxwm_init(ctx)
 struct se_context *ctx;
 {
-	/* Wait for flow control state machine to be idle before changing duplex
-	 * mode or flow control settings */
-	while (!(ENC624J600_READ_REG(ctx->base_address, ESTAT) &
-		 ESTAT_FCIDLE)) {
-	};
-
-	if (ENC624J600_READ_REG(ctx->base_address, ESTAT) & ESTAT_PHYDPX) {
-		/* Full duplex */
-		ENC624J600_SET_BITS(ctx->base_address, MACON2, MACON2_FULDPX);
-		ENC624J600_WRITE_REG(ctx->base_address, MABBIPG,
-				     0x15 << MABBIPG_BBIPG_SHIFT);
-		/* Enable automtaic flow control */
-		ENC624J600_SET_BITS(ctx->base_address, ECON2, ECON2_AUTOFC);
-	} else {
-		/* Half duplex */
-		ENC624J600_CLEAR_BITS(ctx->base_address, MACON2, MACON2_FULDPX);
-		ENC624J600_WRITE_REG(ctx->base_address, MABBIPG,
-				     0x12 << MABBIPG_BBIPG_SHIFT);
-		/* Disable automatic flow control */
-		ENC624J600_CLEAR_BITS(ctx->base_address, ECON2, ECON2_AUTOFC);
-		/* Ensure flow control is deasserted */
-		ENC624J600_CLEAR_BITS(ctx->base_address, ECON1,
-				      ECON1_FCOP1 | ECON1_FCOP1);
+	register struct se_rxwm *wm = &ctx->rxwm;
+	unsigned short size = (SE_RXEND - ctx->rxstart) / SE_WMUNIT;
+
+	if (wm->rw_size != size) {
+		bzero((caddr_t)wm, sizeof(*wm));
+		wm->rw_size = size;
+		wm->rw_min = size / 2;
+		wm->rw_max = size - SE_WMHEADROOM;
+		wm->rw_hwm = size - size / 4;
+		if (wm->rw_hwm > wm->rw_max) {
+			wm->rw_hwm = wm->rw_max;
+		}
 	}
+	ctx->wmperiod = 0;
+	ctx->wmpeak = 0;
+	ctx->wmaborts = 0;
+	se_rxwm_set(ctx, ctx->wmtune ? wm->rw_hwm : size - size / 4);
 }
 
-/* Update the ENC624J600 multicast hash table from our reference-count array */
-INTERNAL void se_update_multicast(ctx)
+/* Set the high watermark to hwm, and the low watermark to 2/3 of that */
+INTERNAL void se_rxwm_set(ctx, hwm)
 struct se_context *ctx;
+int hwm;
 {
-	unsigned short reg;
-	unsigned short bit;
-	unsigned short table[4];
-
-	/* Build multicast hash table bits */
-	for (reg = 0; reg < 4; reg++) {
-		table[reg] = 0;
-		for (bit = 0; bit < 16; bit++) {
-			if (ctx->mcast_refcount[(reg * 16) + bit]) {
-				table[reg] |= BIT(bit);
-			}
-		}
-	}
+	register struct se_rxwm *wm = &ctx->rxwm;
 
-	ENC624J600_WRITE_REG(ctx->base_address, EHT1, SWAPBYTES(table[0]));
-	ENC624J600_WRITE_REG(ctx->base_address, EHT2, SWAPBYTES(table[1]));
-	ENC624J600_WRITE_REG(ctx->base_address, EHT3, SWAPBYTES(table[2]));
-	ENC624J600_WRITE_REG(ctx->base_address, EHT4, SWAPBYTES(table[3]));
+	wm->rw_hwm = hwm;
+	wm->rw_lwm = hwm * 2 / 3;
+	ENC624J600_WRITE_REG(ctx->base_address, ERXWM,
+			     (wm->rw_hwm << ERXWM_RXFWM_SHIFT) |
+				     (wm->rw_lwm << ERXWM_RXEWM_SHIFT));
 }
 
-/* Calculate a bit position in the multicast hash table. Bits 28:23 of the CRC32
- * of the destination address. */
-INTERNAL int se_multicast_hash(addr)
-unsigned char *addr;
+/* Note how full the receive ring is, and every SE_WMPERIOD samples, consider
+ * moving the watermarks. Called from the ISR. */
+INTERNAL void se_rxwm_sample(ctx)
+struct se_context *ctx;
 {
-	int i, j;
-	unsigned int crc;
-	unsigned char byte;
+	register struct se_rxwm *wm = &ctx->rxwm;
+	unsigned short head, size, occ;
+
+	head = ENC624J600_READ_REG(ctx->base_address, ERXHEAD);
+	head = SWAPBYTES(head);
+	size = SE_RXEND - ctx->rxstart;
+	if (head >= ctx->rxptr) {
+		occ = head - ctx->rxptr;
+	} else {
+		occ = size - (ctx->rxptr - head);
+	}
+	if (occ >= size) {
+		/* Shouldn't happen, but don't trust the chip too far */
+		return;
+	}
 
-	crc = 0xffffffff;
-	for (i = 0; i < 6; i++) {
-		byte = addr[i];
-		for (j = 0; j < 8; j++) {
-			if ((byte & 1) ^ (crc >> 31)) {
-				crc <<= 1;
-				crc ^= CRCPOLY;
-			} else {
-				crc <<= 1;
-			}
-			byte >>= 1;
+	wm->rw_samples++;
+	wm->rw_hist[(unsigned long)occ * SE_WMBUCKETS / size]++;
+	occ /= SE_WMUNIT;
+	if (occ > ctx->wmpeak) {
+		ctx->wmpeak = occ;
+	}
+	if (++ctx->wmperiod >= SE_WMPERIOD) {
+		if (ctx->wmtune) {
+			se_rxwm_tune(ctx);
 		}
+		ctx->wmperiod = 0;
+		ctx->wmpeak = 0;
+		ctx->wmaborts = 0;
 	}
-
-	return (crc >> 23) & 0x3f;
 }
 
-/* Write an mbuf chain to the transmit buffer */
-INTERNAL int se_put(ctx, m)
-struct se_context * ctx;
-struct mbuf *m;
+/* Move the high watermark in the light of the last period's samples. If the
+ * ring overflowed, PAUSE went out too late (or not at all), so bring it down.
+ * If the ring got past the high watermark, so that PAUSE went out, but still
+ * had plenty of room left at its fullest, PAUSE went out too soon, so push it
+ * up. Otherwise there's nothing to go on, so leave it alone. */
+INTERNAL void se_rxwm_tune(ctx)
+struct se_context *ctx;
 {
-	register struct mbuf *mp;
-	register int totlen;
-	register unsigned char *bp;
-
-	for (bp = ctx->base_address, mp = m, totlen = 0; mp; mp = mp->m_next) {
-		register unsigned mlen = mp->m_len;
-
-		totlen += mlen;
-		if (mlen == 0) {
-			continue;
+	register struct se_rxwm *wm = &ctx->rxwm;
+	unsigned short hwm = wm->rw_hwm;
+
+	if (ctx->wmaborts) {
+		if (hwm > wm->rw_min) {
+			hwm = hwm > wm->rw_min + SE_WMSTEP ?
+				      hwm - SE_WMSTEP : wm->rw_min;
+			wm->rw_lowers++;
+		}
+	} else if (ctx->wmpeak >= hwm &&
+		   ctx->wmpeak + SE_WMHEADROOM < wm->rw_size) {
+		if (hwm < wm->rw_max) {
+			hwm = hwm + SE_WMSTEP < wm->rw_max ?
+				      hwm + SE_WMSTEP : wm->rw_max;
+			wm->rw_raises++;
 		}
-		bcopy(mtod(mp, unsigned char *), bp, mlen);
-		bp += mlen;
 	}
-	m_freem(m);
-	return totlen;
+	if (hwm != wm->rw_hwm) {
+		se_rxwm_set(ctx, hwm);
+	}
 }
 
-/* Called by timeout() at end of se_rxbuf_reset(). Clears reset counter after a
- * a while so we can differentiate between a one-off error or a card/driver
- * that's gone haywire */
-INTERNAL void se_reset_counter_clear(p)
-void *p;
+/* Wait for any in-progress receive to finish, then discard every packet waiting
+ * in the receive ring. Returns the number of packets dropped. Reception must be
+ * disabled. */
+INTERNAL int se_rxbuf_clear(ctx)
+struct se_context *ctx;
 {
-	struct se_context * ctx = (struct se_context *) p;
-	ctx->reset_counter = 0;
+	int dropcnt = 0;
 
-	printf("se%d: reset counter cleared\n", ctx->ac.ac_if.if_unit);
+	/* Wait for any in-progress receive to finish */
+	while (ENC624J600_READ_REG(ctx->base_address, ESTAT) & ESTAT_RXBUSY) {};
+
+	/* Clear all pending packets */
+	while (ENC624J600_READ_REG(ctx->base_address, EIR) & EIR_PKTIF) {
+		ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_PKTDEC);
+		dropcnt++;
+	}
+	return dropcnt;
 }
 
 /* Attempt to recover from loss-of-state errors by re-initialising the receive
@@ -910,39 +3084,34 @@ void *p;
 INTERNAL void se_rxbuf_reset(ctx)
 struct se_context *ctx;
 {
-	int dropcnt = 0;
+	int dropcnt;
 	/* Disable packet reception while we fiddle with the buffer */
 	ENC624J600_CLEAR_BITS(ctx->base_address, ECON1, ECON1_RXEN);
+	ctx->stats.ss_rxresets++;
+	SE_TRACE(ctx, SE_TR_RESET, 0, ctx->rxptr, ctx->reset_counter);
 
 	untimeout(se_reset_counter_clear, ctx);
 	if (ctx->reset_counter++ > MAX_RESETS) {
-		/* give up and leave interface disabled */
+		/* give up and leave interface disabled. Throw away anything
+		 * still in the ring so that the ISR doesn't keep coming back
+		 * for it. */
 		printf("se%d: in jail for buffer crimes\n",
 		       ctx->ac.ac_if.if_unit);
+		se_rxbuf_clear(ctx);
 		return;
 	}
 
 	printf("se%d: dazed and confused, but trying to continue. rxptr=%x\n",
 	       ctx->ac.ac_if.if_unit, ctx->rxptr);
 
-	/* Wait for any in-progress receive to finish */
-	while (ENC624J600_READ_REG(ctx->base_address, ESTAT) & ESTAT_RXBUSY) {};
-
-	/* Clear all pending packets */
-	while (ENC624J600_READ_REG(ctx->base_address, EIR) & EIR_PKTIF) {
-		ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_PKTDEC);
-		dropcnt++;
-	}
+	dropcnt = se_rxbuf_clear(ctx);
 	if (dropcnt) {
 		printf("se%d: dropped %d packets during rx buffer recovery\n",
 		ctx->ac.ac_if.if_unit, dropcnt);
 	}
 
 	/* Restore buffer pointers to their initial conditions. */
-	ENC624J600_WRITE_REG(ctx->base_address, ERXST, SWAPBYTES(SE_RXSTART));
-	ENC624J600_WRITE_REG(ctx->base_address, ERXTAIL,
-				SWAPBYTES(SE_RXEND - 2));
-	ctx->rxptr = SE_RXSTART;
+	se_rxbuf_init(ctx);
 	
 	/* Good to go, post a callback to clear reset counter if no more resets
 	 * happen for a while */
@@ -950,6 +3119,162 @@ struct se_context *ctx;
 	ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_RXEN);
 }
 
+/* We've lost our place in the receive ring. Try to find it again, and if that
+ * fails, start the ring afresh. taken is as for se_rpkt(). */
+INTERNAL void se_rxlost(ctx, taken)
+struct se_context *ctx;
+int taken;
+{
+	if (!se_rxresync(ctx, taken)) {
+		se_rxbuf_reset(ctx);
+	}
+}
+
+/* Look for a frame in the receive ring that we can carry on from, after
+ * se_rxhdr() has found garbage at the read pointer. Starting at the read
+ * pointer (or, if that is out of the ring altogether, just after ERXTAIL, which
+ * is as far as we last told the chip we'd read), we try each even offset in
+ * turn. The first one from which a chain of plausible frames leads exactly to
+ * ERXHEAD, where the chip will put the next frame, is taken as the next good
+ * frame. The frames in that chain are kept, and the rest of the ring is thrown
+ * away. With a 16-bit next pointer and a length that have to agree at every
+ * step, a chain that ends in the right place by chance is very unlikely.
+ *
+ * This runs in the ISR, and following a chain from every offset in the ring
+ * could take a very long time, so we give up after SE_RESYNC_CHECKS frame
+ * headers have been checked, all told. Resetting the ring loses little more.
+ *
+ * taken is the number of frames the caller has already taken off the ring in
+ * this receive pass. They still count in the chip's packet counter, but they
+ * weren't lost, so they aren't counted as dropped.
+ *
+ * Returns 1 if the read pointer was moved to a good frame, in which case every
+ * frame before it has been released to the chip, so the caller mustn't release
+ * any. Returns 0, with reception disabled, if none was found. */
+INTERNAL int se_rxresync(ctx, taken)
+struct se_context *ctx;
+int taken;
+{
+	register unsigned short p, q;
+	unsigned short head, tail, start;
+	unsigned int ringsize, scanned;
+	int count, kept, dropped, checks = 0;
+
+	/* Stop the chip adding to the ring while we look at it */
+	ENC624J600_CLEAR_BITS(ctx->base_address, ECON1, ECON1_RXEN);
+	while (ENC624J600_READ_REG(ctx->base_address, ESTAT) & ESTAT_RXBUSY) {};
+
+	head = ENC624J600_READ_REG(ctx->base_address, ERXHEAD);
+	head = SWAPBYTES(head);
+	count = (ENC624J600_READ_REG(ctx->base_address, ESTAT) &
+		 ESTAT_PKTCNT_MASK) >> ESTAT_PKTCNT_SHIFT;
+	ringsize = SE_RXEND - ctx->rxstart;
+
+	start = ctx->rxptr;
+	if (start % 2 || start < ctx->rxstart || start >= SE_RXEND) {
+		tail = ENC624J600_READ_REG(ctx->base_address, ERXTAIL);
+		start = SWAPBYTES(tail) + 2;
+		if (start >= SE_RXEND) {
+			start = ctx->rxstart;
+		}
+	}
+
+	kept = -1;
+	for (p = start, scanned = 0; p != head && scanned < ringsize &&
+	     checks < SE_RESYNC_CHECKS; scanned += 2) {
+		/* Follow the chain from p, as far as the packet count says
+		 * there can be frames */
+		for (q = p, kept = 0; q != head && kept <= count &&
+		     checks++ < SE_RESYNC_CHECKS; kept++) {
+			q = se_rxcheck(ctx, q);
+			if (q == 0) {
+				break;
+			}
+		}
+		if (q == head && kept <= count) {
+			break;
+		}
+		kept = -1;
+
+		p += 2;
+		if (p >= SE_RXEND) {
+			p = ctx->rxstart;
+		}
+	}
+	if (kept < 0) {
+		/* Nothing usable; let the caller reset the ring */
+		return 0;
+	}
+
+	/* Release everything before p. This includes any frames taken off the
+	 * ring earlier in this receive pass, which haven't been released
+	 * yet. Only the rest were lost. (If the read pointer itself was bogus
+	 * and we started from ERXTAIL, the chain may take in frames we've
+	 * already had, so don't let the count go negative.) */
+	dropped = count - kept - taken;
+	if (dropped < 0) {
+		dropped = 0;
+	}
+	while (count-- > kept) {
+		ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_PKTDEC);
+	}
+	tail = p - 2;
+	if (tail < ctx->rxstart) {
+		tail = SE_RXEND - 2;
+	}
+	ENC624J600_WRITE_REG(ctx->base_address, ERXTAIL, SWAPBYTES(tail));
+	ctx->rxptr = p;
+
+	ctx->stats.ss_rxresyncs++;
+	ctx->stats.ss_resyncdrops += dropped;
+	SE_TRACE(ctx, SE_TR_RESYNC, 0, p, dropped);
+	printf("se%d: receive ring resynced at %x, skipped %d bytes, %d "
+	       "frame(s) lost\n", ctx->ac.ac_if.if_unit, p, scanned, dropped);
+
+	ENC624J600_SET_BITS(ctx->base_address, ECON1, ECON1_RXEN);
+	return 1;
+}
+
+/* Check whether a plausible frame starts at offset p of the receive ring: its
+ * next-packet pointer must be in the ring, its receive status vector must say
+ * it was received OK, with a sensible length, and the reserved bits clear, and
+ * the next-packet pointer must point just past the end of it (the chip pads
+ * frames to an even length). Returns the next-packet pointer if so, 0 if
+ * not. */
+INTERNAL unsigned short se_rxcheck(ctx, p)
+struct se_context *ctx;
+unsigned short p;
+{
+	struct se_rxheader h;
+	unsigned short rxptr = ctx->rxptr;
+	unsigned short len, next, end;
+
+	ctx->rxptr = p;
+	se_peekbytes(ctx, (unsigned char *)&h, sizeof(h));
+	ctx->rxptr = rxptr;
+
+	next = SWAPBYTES(h.next);
+	len = SWAPBYTES(h.rsv.pkt_len_le);
+	if (next % 2 || next < ctx->rxstart || next >= SE_RXEND) {
+		return 0;
+	}
+	/* lengths include the CRC */
+	if (len < ETHERMIN + sizeof(struct ether_header) + 4 ||
+	    len > ETHERMTU + sizeof(struct ether_header) + 4) {
+		return 0;
+	}
+	/* RSV bit 23 is Received OK; bits 47-40 are always zero */
+	if (!(h.rsv.bits_23_16 & BIT(7)) || h.rsv.bits_47_40) {
+		return 0;
+	}
+
+	end = p + sizeof(h) + len + (len & 1);
+	if (end >= SE_RXEND) {
+		end -= SE_RXEND - ctx->rxstart;
+	}
+	return end == next ? next : 0;
+}
+
 /* Read len bytes from the receive ring buffer, wrapping around if necessary. */
 INTERNAL void se_getbytes(ctx, dest, len)
 struct se_context * ctx;
@@ -961,36 +3286,130 @@ unsigned short len;
 	unsigned short remainder;
 
 	if (rxptr + len < SE_RXEND) {
-		bcopy(base + rxptr, dest, len);
+		se_copy(base + rxptr, dest, len);
 		rxptr += len;
 	} else {
-		bcopy(base + rxptr, dest, SE_RXEND - rxptr);
+		/* Wrap around the end of the ring. Since the ring end is even,
+		 * the second copy starts out with the same alignment as the
+		 * first. */
+		se_copy(base + rxptr, dest, SE_RXEND - rxptr);
 		dest += SE_RXEND - rxptr;
 		remainder = rxptr + len - SE_RXEND;
-		bcopy(base + SE_RXSTART, dest, remainder);
-		rxptr = SE_RXSTART + remainder;
+		se_copy(base + ctx->rxstart, dest, remainder);
+		rxptr = ctx->rxstart + remainder;
 	}
 	ctx->rxptr = rxptr;
 }
 
-/* Pull a packet off the receive ring, updating ring-buffer pointers accordingly */
-INTERNAL struct mbuf * se_get(ctx)
+/* Copy len bytes from the receive ring at the read pointer, as se_getbytes(),
+ * but leave the read pointer where it was */
+INTERNAL void se_peekbytes(ctx, dest, len)
+struct se_context *ctx;
+unsigned char *dest;
+unsigned short len;
+{
+	unsigned short rxptr = ctx->rxptr;
+
+	se_getbytes(ctx, dest, len);
+	ctx->rxptr = rxptr;
+}
+
+/*
+Copy len bytes from src to dst, where one or other is in the ENC624J600's buffer
+memory. This is where all packet data crosses the PDS bus, so it is worth doing
+better than bcopy():
+
+  - The chip is on a 16-bit bus, so a longword move costs two bus cycles, but
+    only one instruction fetch and loop iteration per four bytes.
+
+  - Once the source is on an even address, most frames are copied with longword
+    moves in unrolled 32-byte blocks. If the destination is odd, the 68030 takes
+    care of the misaligned accesses, which is still far cheaper than moving
+    individual bytes.
+
+  - Trailing words and bytes (odd-length mbufs, ring-wrap tails) are handled
+    explicitly rather than falling back to a byte loop.
+
+test/copytest.c checks this against a plain longword copy, for every alignment
+and a range of lengths and at random, and times the two.
+*/
+INTERNAL void se_copy(src, dst, len)
+register unsigned char *src;
+register unsigned char *dst;
+register unsigned len;
+{
+	register unsigned long *ls, *ld;
+	register unsigned n;
+
+	if (len < SE_COPY_MIN) {
+		while (len--) {
+			*dst++ = *src++;
+		}
+		return;
+	}
+
+	/* Get the source onto an even address */
+	if (SE_ODDADDR(src)) {
+		*dst++ = *src++;
+		len--;
+	}
+
+	ls = (unsigned long *)src;
+	ld = (unsigned long *)dst;
+
+	/* 32-byte blocks */
+	for (n = len >> 5; n; n--) {
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+		*ld++ = *ls++;
+	}
+
+	/* Remaining longwords */
+	for (n = (len >> 2) & 7; n; n--) {
+		*ld++ = *ls++;
+	}
+
+	/* Word and byte tail */
+	src = (unsigned char *)ls;
+	dst = (unsigned char *)ld;
+	if (len & 2) {
+		*(unsigned short *)dst = *(unsigned short *)src;
+		src += 2;
+		dst += 2;
+	}
+	if (len & 1) {
+		*dst = *src;
+	}
+}
+
+/* Read the header of the packet at the read pointer and check it for sanity,
+ * leaving the read pointer at the start of the packet data. Returns the packet
+ * length (excluding the CRC) and stores the next-packet pointer in *nextp. If
+ * the header is bogus, the receive ring is resynced or reset and -1 is
+ * returned. taken is as for se_rpkt(). */
+INTERNAL int se_rxhdr(ctx, taken, nextp)
 struct se_context *ctx;
+int taken;
+unsigned short *nextp;
 {
-	struct mbuf *top;
-	register struct mbuf *m, *mp;
 	struct se_rxheader h;
 	register unsigned short len;
-	unsigned short next, tail;
+	unsigned short next;
 
 	/* A packet will always start on a 16-bit boundary within the receive
 	 * buffer area. If not, then something's wrong and nothing good will
 	 * come of trying to go further. */
-	if (ctx->rxptr % 2 || ctx->rxptr < SE_RXSTART || ctx->rxptr > SE_RXEND) {
+	if (ctx->rxptr % 2 || ctx->rxptr < ctx->rxstart ||
+	    ctx->rxptr > SE_RXEND) {
 		printf("se%d: bogus rxptr %x\n", ctx->ac.ac_if.if_unit,
 		       ctx->rxptr);
-		se_rxbuf_reset(ctx);
-		return 0;
+		se_rxlost(ctx, taken);
+		return -1;
 	}
 
 	se_getbytes(ctx, (unsigned char *) &h, sizeof(struct se_rxheader));
@@ -1000,69 +3419,230 @@ struct se_context *ctx;
 	/* Apply same checks as above to the next-packet pointer. This is a
 	 * "can't happen" situation if the driver and chip are functioning
 	 * correctly, but check anyway just in case I've screwed something up */
-	if (next % 2 || next < SE_RXSTART || next >= SE_RXEND) {
+	if (next % 2 || next < ctx->rxstart || next >= SE_RXEND) {
 		printf("se%d: bogus next-packet pointer %x.\n",
 		       ctx->ac.ac_if.if_unit, next);
-		se_rxbuf_reset(ctx);
-		return 0;
+		se_rxlost(ctx, taken);
+		return -1;
 	}
 
 	/* The ENC624J600 will drop runt and too-long frames. If we read a bad
 	 * length, then either the chip or driver is misbehaving. */
-	if (len + sizeof(struct ether_header) < ETHERMIN
-	    || len + sizeof(struct ether_header) > ETHERMTU) {
+	if (len < ETHERMIN + sizeof(struct ether_header) ||
+	    len > ETHERMTU + sizeof(struct ether_header)) {
 		printf("se%d: bogus packet length %d\n", ctx->ac.ac_if.if_unit,
 		       len);
-		se_rxbuf_reset(ctx);
-		return 0;
-	}
- 
-	MGET(top, M_DONTWAIT, MT_DATA);
-	if (top == 0) {
-		DBGP(("se_get failed to get first mbuf\n"));
-		goto done;
+		se_rxlost(ctx, taken);
+		return -1;
 	}
 
-	/* leave space for the interface pointer */
-	top->m_off += sizeof(struct ifnet *);
-	top->m_len = sizeof(struct ether_header);
+	*nextp = next;
+	return len;
+}
 
-	se_getbytes(ctx, mtod(top, unsigned char *),
-		    sizeof(struct ether_header));
-	len -= sizeof(struct ether_header);
+/* Copy a len-byte frame, starting at the read pointer, into a new mbuf chain.
+ * The frame starts SE_RXALIGN bytes into the first mbuf, and is copied in one
+ * piece if it fits in a single mbuf or cluster. Returns 0 if we ran out of
+ * mbufs. */
+INTERNAL struct mbuf * se_get(ctx, len)
+struct se_context *ctx;
+register int len;
+{
+	struct mbuf *top = 0;
+	struct mbuf **mp = &top;
+	register struct mbuf *m;
+	register int off = SE_RXALIGN;
+	SE_PROF_VAR(t0)
 
-	/* get any remaining data into additional mbufs */
-	mp = top;
 	while (len > 0) {
+		SE_PROF_START(t0);
+		m = se_rxpool_get(ctx, len > SE_COPYBREAK ? SE_POOL_CLUST
+							  : SE_POOL_SMALL);
+		SE_PROF_END(ctx, SE_PROF_RXALLOC, t0);
+		if (m == 0) {
+			DBGP(("se_get: failed to get mbuf\n"));
+			if (top) {
+				m_freem(top);
+			}
+			return 0;
+		}
+		m->m_off += off;
+		m->m_len = MIN(m->m_len - off, len);
+		*mp = m;
+		mp = &m->m_next;
+
+		SE_PROF_START(t0);
+		se_getbytes(ctx, mtod(m, unsigned char *), m->m_len);
+		SE_PROF_END(ctx, SE_PROF_RXCOPY, t0);
+		len -= m->m_len;
+		off = 0;
+	}
+	return top;
+}
+
+/* Take an mbuf for received data from one of the reserves (SE_POOL_SMALL for a
+ * small mbuf, SE_POOL_CLUST for a cluster), with m_len set to the space
+ * available in it. If the reserve is empty, falls back to allocating one,
+ * which may give a small mbuf when a cluster was asked for. Schedules a refill
+ * once the reserve is down to half full. Returns 0 if we ran out of mbufs. */
+INTERNAL struct mbuf * se_rxpool_get(ctx, pool)
+struct se_context *ctx;
+int pool;
+{
+	register struct se_rxpool *rp = &ctx->rxpool[pool];
+	register struct mbuf *m;
+	int s;
+
+	s = splimp();
+	m = rp->head;
+	if (m) {
+		rp->head = m->m_next;
+		m->m_next = 0;
+		rp->count--;
+		if (rp->count < rp->lowest) {
+			rp->lowest = rp->count;
+		}
+	}
+	if (rp->count <= ctx->rxpoolsize / 2 && rp->count < ctx->rxpoolsize &&
+	    !ctx->rxpoolfill) {
+		ctx->rxpoolfill = 1;
+		timeout(se_rxpool_fill, ctx, 1);
+	}
+	splx(s);
+
+	if (m == 0) {
+		if (ctx->rxpoolsize) {
+			ctx->stats.ss_poolmiss[pool]++;
+		}
 		MGET(m, M_DONTWAIT, MT_DATA);
 		if (m == 0) {
-			DBGP(("se_get: failed to chain mbuf\n"));
-			m_freem(top);
-			top = 0;
-			goto done;
+			SE_TRACE(ctx, SE_TR_NOMBUF, pool, 0, 0);
+			return 0;
 		}
 		m->m_len = MLEN;
-		mp->m_next = m;
-		mp = m;
-
-		if (len > MCLTHRESHOLD) {
+		if (pool == SE_POOL_CLUST) {
+			/* sets m_len to the cluster size if it worked */
 			MCLGET(m);
 		}
-		/* If we got a cluster with MCLGET(m), then m_len will have
-		 * been set to the cluster size */
-		m->m_len = MIN(m->m_len, len);
+	}
+	return m;
+}
 
-		se_getbytes(ctx, mtod(m, unsigned char *), m->m_len);
-		len -= m->m_len;
+/* Top up the receive mbuf reserves to rxpoolsize (or trim them down to it, if
+ * it has been made smaller). Called by timeout() when a reserve runs low, so
+ * that the allocation is done outside the interrupt handler. If the allocator
+ * is short, the reserve is left short and the next se_rxpool_get() will try
+ * again. */
+INTERNAL void se_rxpool_fill(p)
+void *p;
+{
+	struct se_context *ctx = (struct se_context *)p;
+	register struct se_rxpool *rp;
+	struct mbuf *m;
+	int pool, s;
+
+	s = splimp();
+	ctx->rxpoolfill = 0;
+	for (pool = SE_POOL_SMALL; pool <= SE_POOL_CLUST; pool++) {
+		rp = &ctx->rxpool[pool];
+		while (rp->count > ctx->rxpoolsize) {
+			m = rp->head;
+			rp->head = m->m_next;
+			rp->count--;
+			m_free(m);
+		}
+		while (rp->count < ctx->rxpoolsize) {
+			MGET(m, M_DONTWAIT, MT_DATA);
+			if (m == 0) {
+				break;
+			}
+			m->m_len = MLEN;
+			if (pool == SE_POOL_CLUST) {
+				MCLGET(m);
+				if (m->m_len != MCLBYTES) {
+					m_free(m);
+					break;
+				}
+			}
+			m->m_next = rp->head;
+			rp->head = m;
+			rp->count++;
+		}
 	}
-done:
-	/* tail of receive ring buffer must be at least 2 bytes behind our read
-	 * pointer */
-	tail = next - 2;
-	if (tail < SE_RXSTART) {
-		tail = SE_RXEND - 2;
+	splx(s);
+}
+
+#ifdef SE_PROFILE
+/* Read VIA 1 timer 2. The two halves can't be read at once, so if the high
+ * byte changes while we read the low byte, try again. */
+INTERNAL unsigned short se_prof_now()
+{
+	register volatile unsigned char *via = SE_VIA1;
+	register unsigned char hi, lo;
+
+	do {
+		hi = via[VIA_T2CH];
+		lo = via[VIA_T2CL];
+	} while (hi != via[VIA_T2CH]);
+	return (hi << 8) | lo;
+}
+
+/* Add one timing of ticks to a profiling stage */
+INTERNAL void se_prof_record(ps, ticks)
+register struct se_profstage *ps;
+register unsigned long ticks;
+{
+	register int b;
+
+	if (ps->ps_count++ == 0 || ticks < ps->ps_min) {
+		ps->ps_min = ticks;
 	}
-	ENC624J600_WRITE_REG(ctx->base_address, ERXTAIL, SWAPBYTES(tail));
-	ctx->rxptr = next;
-	return top;
+	if (ticks > ps->ps_max) {
+		ps->ps_max = ticks;
+	}
+	ps->ps_sum += ticks;
+	for (b = 0; ticks && b < SE_PROF_BUCKETS - 1; b++) {
+		ticks >>= 1;
+	}
+	ps->ps_hist[b]++;
+}
+#endif
+
+#ifdef ENC624J600_REGTRACE
+/* Register accessors for a build with ENC624J600_REGTRACE (see
+ * enc624j600_registers.h). Each access is logged in se_regtrace, for
+ * setrace -r to show. These are called for every register access, so don't
+ * put anything in here that touches a register. */
+
+/* Log a register access. The slot comes from the top byte of the address. */
+#define SE_REGLOG(base, reg, val, wr) \
+	do { \
+		register struct se_regrec *rr_; \
+		rr_ = &se_regtrace.rt_rec[se_regtrace.rt_next++ & \
+					  (SE_REGTRACELEN - 1)]; \
+		rr_->rr_reg = (reg); \
+		rr_->rr_value = (val); \
+		rr_->rr_write = (wr); \
+		rr_->rr_slot = (SE_ADDR(base) >> 24) & 0xf; \
+	} while (0)
+
+unsigned short enc624j600_trace_read(base, reg)
+unsigned char *base;
+unsigned short reg;
+{
+	unsigned short val;
+
+	val = *ENC624J600_REG(base, reg);
+	SE_REGLOG(base, reg, val, 0);
+	return val;
 }
+
+void enc624j600_trace_write(base, reg, val)
+unsigned char *base;
+unsigned short reg;
+unsigned short val;
+{
+	*ENC624J600_REG(base, reg) = val;
+	SE_REGLOG(base, reg, val, 1);
+}
+#endif
@@ -3,22 +3,516 @@
 
 #include "enc624j600_registers.h"
 
-/* Calculate ENC624J600 base address from a slot number */
+/* Calculate ENC624J600 base address from a slot number. Can be overridden to
+ * put the chip somewhere else, such as a software model of it. */
+#ifndef SE_BASE
 #define SE_BASE(slot) ((unsigned)0xf0000000 + (slot << 24))
+#endif
 
-/* Start of receive ring buffer, relative to base address */
-#define SE_RXSTART 0x600
+/* Size of a transmit slot. Each slot holds one maximum-length frame, rounded
+ * up to a multiple of 256 bytes. */
+#define SE_TXSLOTSIZE 0x600
 
-/* End of receive ring buffer, relative to base address */
+/* Default number of transmit slots. One frame can be on the wire while the
+ * others are being filled from the send queue. Can be changed at runtime with
+ * the SE_PARAM_TXSLOTS parameter. */
+#define SE_TXSLOTS 3
+
+/* Default receive budget and poll interval (SE_PARAM_RXBUDGET and
+ * SE_PARAM_RXPOLL) */
+#define SE_RXBUDGET 32
+#define SE_RXPOLL 1
+
+/* Default size of each receive mbuf reserve (SE_PARAM_RXPOOL), and the
+ * largest allowed */
+#define SE_RXPOOL 8
+#define SE_MAXRXPOOL 64
+
+/* Default for flow control watermark tuning (see SE_PARAM_WMTUNE) */
+#define SE_WMTUNE 1
+
+/* Number of multicast addresses the driver keeps an exact list of. If more are
+ * subscribed than this, it falls back to trusting the chip's hash filter, but
+ * keeps up to SE_MAXMCOVER more on a list of their own, so that it knows which
+ * addresses are subscribed. */
+#define SE_MAXMCAST 16
+#define SE_MAXMCOVER 32
+
+/* Longest the send queue is allowed to get. se_output() keeps the ethernet
+ * header of each queued frame in a ring of this many entries. */
+#define SE_TXHDRS IFQ_MAXLEN
+
+/* Upper limit on the number of transmit slots, leaving 12K for the receive
+ * ring */
+#define SE_MAXTXSLOTS 8
+
+/* Buffer-memory address of a transmit slot */
+#define SE_TXSLOT(n) ((n) * SE_TXSLOTSIZE)
+
+/* End of receive ring buffer, relative to base address. The receive ring starts
+ * after the last transmit slot. */
 #define SE_RXEND 0x6000
 
+/*
+Driver-private ioctls. These all take a struct ifreq whose ifr_data field points
+to the argument structure in user space.
+*/
+
+/* Get/set a driver parameter */
+#define SIOCSSEPARAM _IOW('i', 200, struct ifreq)
+#define SIOCGSEPARAM _IOWR('i', 201, struct ifreq)
+
+struct se_param {
+	int sp_param;		/* parameter number (SE_PARAM_*) */
+	int sp_value;		/* parameter value */
+};
+
+/* Get/set the hardware pattern-match receive filter */
+#define SIOCSSEPMATCH _IOW('i', 202, struct ifreq)
+#define SIOCGSEPMATCH _IOWR('i', 203, struct ifreq)
+
+/* The chip's pattern-match filter looks at a 64-byte window of each incoming
+ * frame, starting pm_offset bytes from the start of the destination address.
+ * Bit (n % 8) of pm_mask[n / 8] selects byte n of the window, and the frame
+ * matches if every selected byte is equal to the same byte of pm_pattern.
+ * (Strictly, the chip compares a checksum of the selected bytes, so an
+ * unlucky non-matching frame could get through, but never the reverse.) A
+ * frame that ends, counting its 4-byte CRC, before the window does never
+ * matches, so a window at offset 0 is the only one that fits the shortest
+ * (64-byte) frames.
+ *
+ * pm_mode says which frames have to match to be accepted. Unicast frames to
+ * us are always accepted. Be aware that ARP requests are broadcasts, so a
+ * filter that doesn't let them through will stop other hosts finding us
+ * unless they have a static ARP entry for us. */
+struct se_pmatch {
+	int pm_mode;			/* SE_PM_* */
+	unsigned short pm_offset;	/* start of window in frame */
+	unsigned char pm_mask[8];	/* bytes of window to compare */
+	unsigned char pm_pattern[64];	/* what they should contain */
+};
+
+/* Read the driver's statistics. SIOCZSESTATS also zeroes them afterwards. */
+#define SIOCGSESTATS _IOWR('i', 204, struct ifreq)
+#define SIOCZSESTATS _IOWR('i', 205, struct ifreq)
+
+/* Classes of frame that the statistics are broken down by */
+#define SE_CLASS_IP 0		/* IP */
+#define SE_CLASS_ARP 1		/* ARP and RARP */
+#define SE_CLASS_8023 2		/* 802.3 (AppleTalk, mostly) */
+#define SE_CLASS_OTHER 3	/* any other ethernet type */
+#define SE_NCLASSES 4
+
+#define SE_CLASS_NAMES { "ip", "arp", "802.3", "other" }
+
+/* Class of a frame from its ethernet type (or 802.3 length) field */
+#define SE_CLASS(type) ((type) == ETHERTYPE_IP ? SE_CLASS_IP : \
+			(type) == ETHERTYPE_ARP ? SE_CLASS_ARP : \
+			(type) == ETHERTYPE_REVARP ? SE_CLASS_ARP : \
+			(type) <= ETHERMTU ? SE_CLASS_8023 : SE_CLASS_OTHER)
+
+/* Per-class statistics */
+struct se_classstats {
+	unsigned long cs_ipackets;		/* frames received */
+	unsigned long cs_ibytes;		/* bytes received */
+	unsigned long cs_imbufs;		/* mbufs used to receive */
+	unsigned long cs_idrops;		/* frames dropped by driver */
+	unsigned long cs_opackets;		/* frames sent */
+	unsigned long cs_obytes;		/* bytes sent */
+};
+
+/* Driver statistics. The first six counters are copies of the ones in the
+ * interface structure (as shown by netstat -i), and aren't zeroed by
+ * SIOCZSESTATS. */
+struct se_stats {
+	unsigned long ss_ipackets;		/* frames received */
+	unsigned long ss_ierrors;		/* receive errors */
+	unsigned long ss_opackets;		/* frames sent */
+	unsigned long ss_oerrors;		/* transmit errors */
+	unsigned long ss_collisions;		/* collisions */
+	unsigned long ss_oqdrops;		/* send queue overflows */
+
+	/* receive */
+	unsigned long ss_ibytes;		/* bytes received */
+	unsigned long ss_rxabort;		/* receive aborts (ring full) */
+	unsigned long ss_pcfull;		/* packet counter overflows */
+	unsigned long ss_rxresets;		/* receive ring resets */
+	unsigned long ss_rxresyncs;		/* receive ring resyncs */
+	unsigned long ss_resyncdrops;		/* frames lost to resyncs */
+	unsigned long ss_nombuf;		/* frames lost, no mbufs */
+	unsigned long ss_iqdrops;		/* protocol queue overflows */
+	unsigned long ss_unwanted;		/* dropped in ring, unwanted */
+	unsigned long ss_mcastmiss;		/* dropped in ring, mcast */
+	unsigned long ss_notme;			/* dropped in ring, not to us */
+	unsigned long ss_captured;		/* frames captured */
+	unsigned long ss_capbytes;		/* bytes captured */
+	unsigned long ss_rxintrs;		/* rx passes from ISR */
+	unsigned long ss_rxintr_frames;		/* frames received by ISR */
+	unsigned long ss_rxpolls;		/* rx passes from poll */
+	unsigned long ss_rxpoll_frames;		/* frames received by poll */
+	unsigned long ss_rxpoll_ticks;		/* ticks spent polling */
+	unsigned long ss_poolmiss[2];		/* mbuf reserves empty */
+	unsigned long ss_poollow[2];		/* mbuf reserve low water */
+
+	/* transmit */
+	unsigned long ss_obytes;		/* bytes sent */
+	unsigned long ss_deferred;		/* frames deferred */
+	unsigned long ss_exdefer;		/* frames deferred too long */
+	unsigned long ss_latecol;		/* late collisions */
+	unsigned long ss_maxcol;		/* too many collisions */
+	unsigned long ss_txintrs;		/* tx completions by ISR */
+	unsigned long ss_txreaped;		/* tx completions reaped */
+
+	/* broken down by class of frame */
+	struct se_classstats ss_class[SE_NCLASSES];
+};
+
+/* Read the profiling counters of a driver built with SE_PROFILE.
+ * SIOCZSEPROF also zeroes them afterwards. */
+#define SIOCGSEPROF _IOWR('i', 206, struct ifreq)
+#define SIOCZSEPROF _IOWR('i', 207, struct ifreq)
+
+/* Stages of the driver that are timed */
+#define SE_PROF_INTR 0		/* whole interrupt handler */
+#define SE_PROF_RXDRAIN 1	/* one pass over the receive ring */
+#define SE_PROF_RXPKT 2		/* handling one received frame */
+#define SE_PROF_RXALLOC 3	/* getting an mbuf for received data */
+#define SE_PROF_RXCOPY 4	/* copying received data out of the card */
+#define SE_PROF_OUTPUT 5	/* se_output(), up to queueing the frame */
+#define SE_PROF_TXCOPY 6	/* copying a frame into the card */
+#define SE_PROF_TXCSUM 7	/* transmit checksum offload */
+#define SE_PROF_NSTAGES 8
+
+#define SE_PROF_NAMES { "intr", "rxdrain", "rxpkt", "rxalloc", "rxcopy", \
+			"output", "txcopy", "txcsum" }
+
+/* Number of histogram buckets. Bucket 0 counts times of 0 ticks, and bucket n
+ * times of 2^(n-1) to 2^n - 1 ticks, except that the last bucket also counts
+ * anything longer. */
+#define SE_PROF_BUCKETS 16
+
+/* Timings are in ticks of the VIA timer, which runs at 783.36KHz (so a tick is
+ * about 1.28us). Anything over 65535 ticks (about 84ms) wraps around. */
+struct se_profstage {
+	unsigned long ps_count;			/* times timed */
+	unsigned long ps_sum;			/* total ticks */
+	unsigned long ps_min;			/* shortest */
+	unsigned long ps_max;			/* longest */
+	unsigned long ps_hist[SE_PROF_BUCKETS];	/* log2 histogram */
+};
+
+struct se_prof {
+	struct se_profstage sp_stage[SE_PROF_NSTAGES];
+};
+
+/* Read the event trace ring. SIOCZSETRACE also empties it afterwards. */
+#define SIOCGSETRACE _IOWR('i', 208, struct ifreq)
+#define SIOCZSETRACE _IOWR('i', 209, struct ifreq)
+
+/* Number of events kept in the trace ring (a power of 2) */
+#define SE_TRACELEN 256
+
+/* A traced event. What the arguments mean depends on the event. */
+struct se_tracerec {
+	unsigned long tr_time;		/* clock ticks since boot */
+	unsigned char tr_event;		/* SE_TR_* */
+	unsigned char tr_c;		/* arguments */
+	unsigned short tr_a;
+	unsigned short tr_b;
+};
+
+struct se_trace {
+	unsigned long st_next;		/* events recorded so far */
+	struct se_tracerec st_rec[SE_TRACELEN];	/* indexed by event number
+						 * % SE_TRACELEN */
+};
+
+/* Trace events                   c          a          b */
+#define SE_TR_INTR 1		/*            EIR                   */
+#define SE_TR_RXDRAIN 2		/* polled?    PKTCNT     taken      */
+#define SE_TR_RXPKT 3		/* class      rxptr      next ptr   */
+#define SE_TR_RXDROP 4		/* reason     rxptr      length     */
+#define SE_TR_RXFLUSH 5		/*            IP queue   AT queue   */
+#define SE_TR_TXSTART 6		/* slot       length     staged     */
+#define SE_TR_TXDONE 7		/* slot       ETXSTAT    EIR        */
+#define SE_TR_OUTPUT 8		/*            send queue            */
+#define SE_TR_RESET 9		/*            rxptr      resets     */
+#define SE_TR_NOMBUF 10		/* pool       length                */
+#define SE_TR_LINK 11		/*            ESTAT                 */
+#define SE_TR_RESYNC 12		/*            new rxptr  dropped    */
+
+/* Reasons for SE_TR_RXDROP */
+#define SE_TRD_UNWANTED 0	/* nobody wants this type */
+#define SE_TRD_MCAST 1		/* multicast we aren't subscribed to */
+#define SE_TRD_NOMBUF 2		/* no mbufs */
+#define SE_TRD_NOTME 3		/* not addressed to us (promiscuous) */
+
+/* Read the register access log of a driver built with ENC624J600_REGTRACE.
+ * SIOCZSEREGTRACE also empties it afterwards. The log is shared by all units,
+ * so these work on any of them. */
+#define SIOCGSEREGTRACE _IOWR('i', 210, struct ifreq)
+#define SIOCZSEREGTRACE _IOWR('i', 211, struct ifreq)
+
+/* Number of register accesses kept in the log (a power of 2) */
+#define SE_REGTRACELEN 1024
+
+/* A logged register access */
+struct se_regrec {
+	unsigned short rr_reg;		/* register offset */
+	unsigned short rr_value;	/* value read or written, as on the
+					 * bus (i.e. byte-swapped) */
+	unsigned char rr_write;		/* 1 = write, 0 = read */
+	unsigned char rr_slot;		/* slot of card */
+};
+
+struct se_regtrace {
+	unsigned long rt_next;		/* accesses logged so far */
+	struct se_regrec rt_rec[SE_REGTRACELEN];	/* indexed by access
+							 * number %
+							 * SE_REGTRACELEN */
+};
+
+/* Read the receive ring occupancy histogram and the flow control watermarks
+ * chosen from it. SIOCZSERXWM also zeroes the histogram and counters
+ * afterwards. */
+#define SIOCGSERXWM _IOWR('i', 212, struct ifreq)
+#define SIOCZSERXWM _IOWR('i', 213, struct ifreq)
+
+/* Number of histogram buckets, each covering an equal share of the ring */
+#define SE_WMBUCKETS 16
+
+/* Occupancy samples between watermark adjustments */
+#define SE_WMPERIOD 256
+
+/* Sizes and watermarks are in the chip's 96-byte units. Flow control (PAUSE
+ * frames, on full-duplex links) is asserted when the ring fills past rw_hwm,
+ * and released when it empties below rw_lwm. */
+struct se_rxwm {
+	unsigned short rw_size;		/* size of receive ring */
+	unsigned short rw_hwm;		/* high watermark */
+	unsigned short rw_lwm;		/* low watermark */
+	unsigned short rw_min;		/* lowest rw_hwm will go */
+	unsigned short rw_max;		/* highest rw_hwm will go */
+	unsigned long rw_samples;	/* occupancy samples taken */
+	unsigned long rw_raises;	/* times rw_hwm was raised */
+	unsigned long rw_lowers;	/* times rw_hwm was lowered */
+	unsigned long rw_hist[SE_WMBUCKETS];	/* samples by occupancy */
+};
+
+/* Bond several cards into one interface, or show the bond an interface is in.
+ * The interface SIOCSSEBOND is issued on (the master) must be up. It keeps its
+ * address, and all the bond's traffic goes in and out through it; outbound
+ * frames are spread over the cards by flow. The other members must not have
+ * addresses of their own, and take on the master's ethernet address while they
+ * are in the bond. Setting sb_members to just the master dissolves the bond. */
+#define SIOCSSEBOND _IOW('i', 214, struct ifreq)
+#define SIOCGSEBOND _IOWR('i', 215, struct ifreq)
+
+struct se_bond {
+	int sb_master;		/* unit number of master (get only) */
+	int sb_members;		/* bit n set = unit n is in the bond */
+	int sb_active;		/* members with a link (get only) */
+};
+
+/* Get/set the capture filter. While a filter is installed, the card receives
+ * every frame on the wire (promiscuous mode), and the driver runs the filter
+ * program over the start of each one while it is still in the receive ring.
+ * Frames that the program accepts are copied, up to the length it returns and
+ * no more than sf_snaplen bytes, and passed whole (ethernet header and all) to
+ * ETHERLINK raw sockets bound to SE_CAPTURE_TYPE, or to all types. Anything
+ * else that isn't addressed to us is dropped in the ring without being copied.
+ * Setting sf_len to 0 removes the filter and turns promiscuous mode off. The
+ * pattern-match filter (SIOCSSEPMATCH) is ignored while capturing. */
+#define SIOCSSEFILTER _IOW('i', 216, struct ifreq)
+#define SIOCGSEFILTER _IOWR('i', 217, struct ifreq)
+
+/* Longest filter program */
+#define SE_MAXFINSNS 32
+
+/* Bytes at the start of each frame that a filter program can look at. Loads
+ * from further in, or beyond the end of the frame, reject it. */
+#define SE_FPEEK 128
+
+/* Protocol number under which captured frames are passed to raw sockets. No
+ * real ethernet type uses it. */
+#define SE_CAPTURE_TYPE 0xffff
+
+/* A filter instruction. The program is a cut-down BPF: the machine has an
+ * accumulator A and an index register X, both starting at 0, and every jump
+ * is forwards, so a program always finishes. Offsets are from the start of the
+ * destination address, and multi-byte loads are big-endian. */
+struct se_finsn {
+	unsigned short fi_code;		/* SE_F_* */
+	unsigned char fi_jt;		/* instructions to skip if true */
+	unsigned char fi_jf;		/* instructions to skip if false */
+	unsigned long fi_k;		/* operand */
+};
+
+#define SE_F_RET 0		/* accept fi_k bytes of frame (0 = reject) */
+#define SE_F_LDB 1		/* A = byte at fi_k */
+#define SE_F_LDH 2		/* A = 16-bit word at fi_k */
+#define SE_F_LDW 3		/* A = 32-bit word at fi_k */
+#define SE_F_LDBX 4		/* A = byte at X + fi_k */
+#define SE_F_LDHX 5		/* A = 16-bit word at X + fi_k */
+#define SE_F_LDXHL 6		/* X = 4 * (byte at fi_k & 0xf), i.e. the
+				 * length of the IP header at fi_k */
+#define SE_F_LEN 7		/* A = length of frame */
+#define SE_F_AND 8		/* A &= fi_k */
+#define SE_F_JEQ 9		/* skip fi_jt if A == fi_k, else fi_jf */
+#define SE_F_JGT 10		/* skip fi_jt if A > fi_k, else fi_jf */
+#define SE_F_JSET 11		/* skip fi_jt if A & fi_k, else fi_jf */
+#define SE_F_NCODES 12
+
+struct se_filter {
+	int sf_len;			/* instructions in program */
+	int sf_snaplen;			/* most bytes of a frame to copy, from
+					 * 14 up (more than a full frame is
+					 * cut down to one) */
+	struct se_finsn sf_prog[SE_MAXFINSNS];	/* program */
+};
+
+#define SE_PM_OFF 0		/* no filter */
+#define SE_PM_BCAST 1		/* broadcasts must match */
+#define SE_PM_NOTUCAST 2	/* broadcasts and multicasts must match */
+
+/* Number of transmit slots (1 to SE_MAXTXSLOTS). The rest of buffer memory is
+ * used for the receive ring. Changing this drops any frames in the receive
+ * ring. */
+#define SE_PARAM_TXSLOTS 1
+
+/* Transmit checksum offload (0 = off, 1 = on). When on, the card's DMA
+ * checksum engine fills in the IP header checksum and TCP/UDP checksum of
+ * outbound IP packets wherever the stack has left the field as zero, so a stack
+ * that knows about this (see se_txcsum_offload()) can skip computing them. A
+ * recomputed checksum always comes out the same, so packets that were already
+ * checksummed are unaffected. */
+#define SE_PARAM_TXCSUM 2
+
+/* Receive budget: the most packets taken off the receive ring per interrupt or
+ * poll. If packets are still waiting once the budget is spent, the receive
+ * interrupt is masked and the ring is polled every SE_PARAM_RXPOLL ticks until
+ * it is empty, so a flood of incoming packets can't starve the rest of the
+ * system. 0 means no limit, i.e. never poll. */
+#define SE_PARAM_RXBUDGET 3
+
+/* Receive poll interval, in clock ticks (at least 1) */
+#define SE_PARAM_RXPOLL 4
+
+/* Deferred receive (0 = off, 1 = on). When on, the ISR doesn't copy anything
+ * out of the receive ring; it masks the receive interrupt and leaves the work
+ * to the receive poll on the next clock tick, which runs at a lower priority.
+ * This cuts worst-case interrupt latency for other devices (such as serial
+ * ports) at the cost of up to a tick of receive latency. */
+#define SE_PARAM_SOFTRX 5
+
+/* Receive mbuf reserve size (0 to SE_MAXRXPOOL). The driver keeps this many
+ * small mbufs and this many clusters set aside for received frames, and tops
+ * them up from a timeout rather than allocating in the interrupt handler. If a
+ * reserve runs dry, it falls back to allocating as normal. 0 turns the reserve
+ * off. */
+#define SE_PARAM_RXPOOL 6
+
+/* Event tracing (0 = off, 1 = on). When on, the driver records what it is up
+ * to in a ring of SE_TRACELEN events, which can be read with SIOCGSETRACE (or
+ * the setrace utility). */
+#define SE_PARAM_TRACE 7
+
+/* Lazy transmit completion (0 = off, 1 = on). When on, the transmit-complete
+ * interrupt is masked while the frame on the wire is the last one there is to
+ * send. Its completion is picked up instead the next time se_output() is
+ * called, when any other interrupt or receive poll comes along, and otherwise
+ * from a timeout on the next clock tick. While there are more frames to go,
+ * the interrupt stays on, so that a burst goes out back to back. This saves an
+ * interrupt per frame when frames are sent one at a time; the cost is that a
+ * transmit slot can stay in use for up to a tick after its frame has gone. */
+#define SE_PARAM_TXLAZY 8
+
+/* Flow control watermark tuning (0 = off, 1 = on). When on, the driver samples
+ * how full the receive ring is at each interrupt, and every SE_WMPERIOD samples
+ * moves the high watermark: down if the ring overflowed, so that PAUSE frames
+ * go out sooner, or up if flow control was asserted but the ring never came
+ * close to filling, so that the sender isn't held up for nothing. When off, the
+ * watermarks are 3/4 and 1/2 of the ring. */
+#define SE_PARAM_WMTUNE 9
+
+#ifdef KERNEL
+/* A reserve of mbufs for received frames, linked through m_next */
+struct se_rxpool {
+	struct mbuf *head;			/* first free mbuf */
+	unsigned short count;			/* mbufs in reserve */
+	unsigned short lowest;			/* low-water mark */
+};
+
+/* A subscribed multicast address */
+struct se_mcast {
+	unsigned short addr[3];			/* address */
+	unsigned short refcount;		/* subscriptions */
+};
+
+/* Ethernet header of a frame on the send queue. se_start() writes it straight
+ * into the transmit slot, ahead of the mbuf chain, so se_output() doesn't have
+ * to find room for it in the chain. */
+struct se_txhdr {
+	unsigned char dhost[6];			/* destination address */
+	unsigned short type;			/* ethernet type (even if
+						 * inmbuf) */
+	unsigned char inmbuf;			/* chain has its own header */
+};
+
+/* Indices into se_context.rxpool */
+#define SE_POOL_SMALL 0
+#define SE_POOL_CLUST 1
+
 struct se_context {
 	struct arpcom ac;
 	unsigned char *base_address;		/* base address of chip */
+	unsigned short rxstart;			/* start of rx ring */
 	unsigned short rxptr;			/* read pointer for rx ring */
+	unsigned char ntxslots;			/* number of tx slots */
+	unsigned short txlen[SE_MAXTXSLOTS];	/* lengths of staged frames */
+	unsigned char txclass[SE_MAXTXSLOTS];	/* classes of staged frames */
+	unsigned char txhead;			/* next tx slot to fill */
+	unsigned char txtail;			/* tx slot on the wire */
+	unsigned char txcount;			/* number of staged tx frames */
+	unsigned char txcsum;			/* tx checksum offload on */
+	struct se_txhdr txhdr[SE_TXHDRS];	/* headers of queued frames */
+	unsigned char txhdrnext;		/* txhdr of queue head */
+	unsigned char txlazy;			/* lazy tx completion on */
+	unsigned char txmasked;			/* tx interrupt masked */
+	unsigned char txreaping;		/* tx reap timeout pending */
+	unsigned char linkpend;			/* link change pending */
+	unsigned short linkwait;		/* ticks waited for FC idle */
+	unsigned char wmtune;			/* watermark tuning on */
+	struct se_rxwm rxwm;			/* ring occupancy, watermarks */
+	unsigned short wmperiod;		/* samples this period */
+	unsigned short wmpeak;			/* peak occupancy this period */
+	unsigned short wmaborts;		/* rx aborts this period */
+	unsigned char linkup;			/* link is up */
+	unsigned char bondmask;			/* units in our bond (master) */
+	struct se_context *bondmaster;		/* master of our bond, or 0 */
+	unsigned short ownaddr[3];		/* own address while bonded */
+	unsigned short rxbudget;		/* max rx packets per pass */
+	unsigned short rxpollticks;		/* rx poll interval */
+	unsigned char rxpolling;		/* in polled rx mode */
+	unsigned char softrx;			/* deferred rx enabled */
+	struct se_stats stats;			/* statistics */
+	unsigned char tracing;			/* event tracing on */
+	struct se_trace trace;			/* event trace ring */
+#ifdef SE_PROFILE
+	struct se_prof prof;			/* profiling counters */
+#endif
+	struct se_rxpool rxpool[2];		/* rx mbuf reserves */
+	unsigned short rxpoolsize;		/* target reserve size */
+	unsigned char rxpoolfill;		/* reserve refill pending */
 	volatile unsigned int reset_counter;
 	volatile struct timeval last_reset;
 	unsigned char mcast_refcount[64];	/* multicast reference counts */
+	struct se_mcast mcast[SE_MAXMCAST];	/* subscribed addresses */
+	unsigned char nmcast;			/* entries in mcast */
+	struct se_mcast mcover[SE_MAXMCOVER];	/* ones that didn't fit */
+	unsigned char nmcover;			/* entries in mcover */
+	struct se_pmatch pmatch;		/* pattern-match filter */
+	struct se_filter filter;		/* capture filter */
 };
 
 /* Ring buffer header at the start of each packet */
@@ -26,3 +520,11 @@ struct se_rxheader {
 	unsigned short next; 		/* offset of next packet */
 	struct enc624j600_rsv rsv;	/* receive status vector */
 };
+
+/* Packets taken off the receive ring in one pass, waiting to be queued for
+ * their protocols */
+struct se_rxbatch {
+	struct ifqueue ipq;		/* IP packets */
+	struct ifqueue etq;		/* AppleTalk packets */
+};
+#endif /* KERNEL */
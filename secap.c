@@ -0,0 +1,236 @@
+/* secap - capture frames from an SEthernet/30 card under A/UX
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: secap [-s snaplen] [-c count] [-x] interface [all | type type |
+ *                                                      host addr | port port]
+ *
+ * Puts the card into promiscuous mode with a capture filter that accepts
+ * frames of the given ethernet type, IP packets to or from the given host, or
+ * TCP or UDP packets to or from the given port (or everything), and prints a
+ * line for each frame the driver passes up. The filter runs in the driver, so
+ * frames that don't match cost next to nothing, however busy the segment is.
+ * -s sets how many bytes of each frame are copied up (default 96), -c stops
+ * after that many frames, and -x dumps the bytes of each frame as well.
+ * Requires root. The filter is removed again on exit or interrupt.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include "if_se.h"
+
+char *progname;
+char *ifname;
+int s;
+
+usage()
+{
+	fprintf(stderr, "usage: %s [-s snaplen] [-c count] [-x] interface "
+		"[all | type type | host addr | port port]\n", progname);
+	exit(1);
+}
+
+/* Append an instruction to a filter program */
+add(f, code, jt, jf, k)
+struct se_filter *f;
+int code, jt, jf;
+unsigned long k;
+{
+	register struct se_finsn *fi = &f->sf_prog[f->sf_len++];
+
+	fi->fi_code = code;
+	fi->fi_jt = jt;
+	fi->fi_jf = jf;
+	fi->fi_k = k;
+}
+
+/* Parse a dotted-quad IP address */
+unsigned long ipaddr(str)
+char *str;
+{
+	int a, b, c, d;
+
+	if (sscanf(str, "%d.%d.%d.%d", &a, &b, &c, &d) != 4) {
+		usage();
+	}
+	return ((unsigned long)a << 24) | (b << 16) | (c << 8) | d;
+}
+
+/* Build the filter program for the words after the interface name */
+build(f, argc, argv)
+struct se_filter *f;
+int argc;
+char **argv;
+{
+	unsigned long val;
+	long strtol();
+
+	f->sf_len = 0;
+	if (argc == 0 || (argc == 1 && strcmp(argv[0], "all") == 0)) {
+		add(f, SE_F_RET, 0, 0, f->sf_snaplen);
+		return;
+	}
+	if (argc != 2) {
+		usage();
+	}
+
+	if (strcmp(argv[0], "type") == 0) {
+		val = strtol(argv[1], (char **)0, 0);
+		add(f, SE_F_LDH, 0, 0, 12);
+		add(f, SE_F_JEQ, 0, 1, val);
+		add(f, SE_F_RET, 0, 0, f->sf_snaplen);
+		add(f, SE_F_RET, 0, 0, 0);
+	} else if (strcmp(argv[0], "host") == 0) {
+		/* IP, source or destination address */
+		val = ipaddr(argv[1]);
+		add(f, SE_F_LDH, 0, 0, 12);
+		add(f, SE_F_JEQ, 0, 5, ETHERTYPE_IP);
+		add(f, SE_F_LDW, 0, 0, 26);
+		add(f, SE_F_JEQ, 2, 0, val);
+		add(f, SE_F_LDW, 0, 0, 30);
+		add(f, SE_F_JEQ, 0, 1, val);
+		add(f, SE_F_RET, 0, 0, f->sf_snaplen);
+		add(f, SE_F_RET, 0, 0, 0);
+	} else if (strcmp(argv[0], "port") == 0) {
+		/* IP, TCP or UDP, first fragment, source or destination port.
+		 * The ports come after the IP header, however long it is. */
+		val = strtol(argv[1], (char **)0, 0);
+		add(f, SE_F_LDH, 0, 0, 12);
+		add(f, SE_F_JEQ, 0, 11, ETHERTYPE_IP);
+		add(f, SE_F_LDB, 0, 0, 23);
+		add(f, SE_F_JEQ, 1, 0, 6);
+		add(f, SE_F_JEQ, 0, 8, 17);
+		add(f, SE_F_LDH, 0, 0, 20);
+		add(f, SE_F_JSET, 6, 0, 0x1fff);
+		add(f, SE_F_LDXHL, 0, 0, 14);
+		add(f, SE_F_LDHX, 0, 0, 14);
+		add(f, SE_F_JEQ, 2, 0, val);
+		add(f, SE_F_LDHX, 0, 0, 16);
+		add(f, SE_F_JEQ, 0, 1, val);
+		add(f, SE_F_RET, 0, 0, f->sf_snaplen);
+		add(f, SE_F_RET, 0, 0, 0);
+	} else {
+		usage();
+	}
+}
+
+/* Install a filter, or remove it if sf_len is 0 */
+int setfilter(f)
+struct se_filter *f;
+{
+	struct ifreq ifr;
+
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (caddr_t)f;
+	return ioctl(s, SIOCSSEFILTER, (caddr_t)&ifr);
+}
+
+/* Remove the filter and leave */
+done()
+{
+	struct se_filter f;
+
+	f.sf_len = 0;
+	if (setfilter(&f) < 0) {
+		perror(ifname);
+		exit(1);
+	}
+	exit(0);
+}
+
+/* Print an ethernet address */
+prether(p)
+unsigned char *p;
+{
+	printf("%02x:%02x:%02x:%02x:%02x:%02x", p[0], p[1], p[2], p[3], p[4],
+	       p[5]);
+}
+
+main(argc, argv)
+int argc;
+char **argv;
+{
+	static struct se_filter f;
+	static unsigned char buf[ETHERMTU + sizeof(struct ether_header)];
+	long count = -1, strtol();
+	int hex = 0, len, i;
+
+	progname = argv[0];
+	f.sf_snaplen = 96;
+	while (argc > 2 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-x") == 0) {
+			hex = 1;
+		} else if (strcmp(argv[1], "-s") == 0) {
+			f.sf_snaplen = (int)strtol(argv[2], (char **)0, 0);
+			argv++;
+			argc--;
+		} else if (strcmp(argv[1], "-c") == 0) {
+			count = strtol(argv[2], (char **)0, 0);
+			argv++;
+			argc--;
+		} else {
+			usage();
+		}
+		argv++;
+		argc--;
+	}
+	if (argc < 2) {
+		usage();
+	}
+	ifname = argv[1];
+	if (f.sf_snaplen <= 0) {
+		usage();
+	}
+	if (f.sf_snaplen > (int)sizeof(buf)) {
+		f.sf_snaplen = sizeof(buf);
+	}
+	build(&f, argc - 2, argv + 2);
+
+	/* Open the socket that captured frames arrive on before turning
+	 * capture on, so that none are missed */
+	s = socket(PF_ETHERLINK, SOCK_RAW, SE_CAPTURE_TYPE);
+	if (s < 0) {
+		perror("socket");
+		exit(1);
+	}
+	signal(SIGINT, done);
+	signal(SIGTERM, done);
+	if (setfilter(&f) < 0) {
+		perror(ifname);
+		exit(1);
+	}
+
+	while (count != 0) {
+		len = recv(s, (char *)buf, sizeof(buf), 0);
+		if (len < 0) {
+			perror("recv");
+			break;
+		}
+		if (len < sizeof(struct ether_header)) {
+			continue;
+		}
+		prether(buf + 6);
+		printf(" > ");
+		prether(buf);
+		printf(" type %04x, %d bytes\n", (buf[12] << 8) | buf[13], len);
+		if (hex) {
+			for (i = 0; i < len; i++) {
+				printf("%s%02x", i % 16 ? " " : "  ", buf[i]);
+				if (i % 16 == 15 || i == len - 1) {
+					printf("\n");
+				}
+			}
+		}
+		fflush(stdout);
+		if (count > 0) {
+			count--;
+		}
+	}
+	done();
+}
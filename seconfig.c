@@ -0,0 +1,302 @@
+/* seconfig - get and set SEthernet/30 driver parameters under A/UX
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: seconfig interface [parameter [value]]
+ *        seconfig interface pmatch [off | ethertype type | udpport port]
+ *                                  [bcast | mcast]
+ *        seconfig interface bond [off | member ...]
+ *
+ * With no parameter, prints the current value of every parameter. With a
+ * parameter but no value, prints that parameter. Setting a parameter requires
+ * root.
+ *
+ * The pmatch form shows or sets the hardware pattern-match filter, which makes
+ * the card throw away broadcasts (or broadcasts and multicasts, with mcast)
+ * other than those of the given ethertype or to the given UDP port.
+ *
+ * The bond form shows or sets the cards bonded with the interface, which must
+ * be up. Members are named like interfaces (se1, se2), and must not have
+ * addresses of their own. "off" dissolves the bond.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include "if_se.h"
+
+struct paramname {
+	char *name;
+	int param;
+	char *desc;
+};
+
+struct paramname params[] = {
+	{ "txslots", SE_PARAM_TXSLOTS,
+	  "transmit slots (rest of buffer memory is rx ring)" },
+	{ "txcsum", SE_PARAM_TXCSUM,
+	  "fill in zeroed IP/TCP/UDP checksums in hardware (0/1)" },
+	{ "rxbudget", SE_PARAM_RXBUDGET,
+	  "max packets received per interrupt or poll (0 = no limit)" },
+	{ "rxpoll", SE_PARAM_RXPOLL,
+	  "receive poll interval in clock ticks" },
+	{ "softrx", SE_PARAM_SOFTRX,
+	  "defer all receive work from the ISR to the next tick (0/1)" },
+	{ "rxpool", SE_PARAM_RXPOOL,
+	  "mbufs and clusters kept in reserve for receive (0 = off)" },
+	{ "trace", SE_PARAM_TRACE,
+	  "record driver events for setrace (0/1)" },
+	{ "txlazy", SE_PARAM_TXLAZY,
+	  "mask tx interrupts while more frames are waiting (0/1)" },
+	{ "wmtune", SE_PARAM_WMTUNE,
+	  "tune flow control watermarks to receive ring use (0/1)" },
+	{ 0, 0, 0 }
+};
+
+char *progname;
+
+usage()
+{
+	struct paramname *p;
+
+	fprintf(stderr, "usage: %s interface [parameter [value]]\n",
+		progname);
+	fprintf(stderr, "       %s interface pmatch [off | ethertype type | "
+		"udpport port] [bcast | mcast]\n", progname);
+	fprintf(stderr, "       %s interface bond [off | member ...]\n",
+		progname);
+	fprintf(stderr, "parameters:\n");
+	for (p = params; p->name; p++) {
+		fprintf(stderr, "  %-12s %s\n", p->name, p->desc);
+	}
+	exit(1);
+}
+
+/* Issue a driver-private ioctl against the named interface */
+int se_ioctl(s, ifname, cmd, arg)
+int s;
+char *ifname;
+int cmd;
+caddr_t arg;
+{
+	struct ifreq ifr;
+
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	ifr.ifr_data = arg;
+	return ioctl(s, cmd, (caddr_t)&ifr);
+}
+
+/* Print the value of one parameter, returning -1 if it could not be read */
+int show(s, ifname, p)
+int s;
+char *ifname;
+struct paramname *p;
+{
+	struct se_param sp;
+
+	sp.sp_param = p->param;
+	if (se_ioctl(s, ifname, SIOCGSEPARAM, (caddr_t)&sp) < 0) {
+		perror(p->name);
+		return -1;
+	}
+	printf("%s %d\n", p->name, sp.sp_value);
+	return 0;
+}
+
+/* Select byte n of a pattern-match window, with the given value */
+setpm(pm, n, val)
+struct se_pmatch *pm;
+int n;
+int val;
+{
+	pm->pm_mask[n / 8] |= 1 << (n % 8);
+	pm->pm_pattern[n] = val;
+}
+
+/* Show or set the pattern-match filter. argv holds the words after "pmatch". */
+int pmatch(s, ifname, argc, argv)
+int s;
+char *ifname;
+int argc;
+char **argv;
+{
+	struct se_pmatch pm;
+	long val, strtol();
+	int i;
+
+	if (argc == 0) {
+		if (se_ioctl(s, ifname, SIOCGSEPMATCH, (caddr_t)&pm) < 0) {
+			perror("pmatch");
+			return 1;
+		}
+		if (pm.pm_mode == SE_PM_OFF) {
+			printf("pmatch off\n");
+			return 0;
+		}
+		printf("pmatch %s offset %d pattern",
+		       pm.pm_mode == SE_PM_BCAST ? "bcast" : "mcast",
+		       pm.pm_offset);
+		for (i = 0; i < sizeof(pm.pm_pattern); i++) {
+			if (pm.pm_mask[i / 8] & (1 << (i % 8))) {
+				printf(" %d:%02x", i, pm.pm_pattern[i]);
+			}
+		}
+		printf("\n");
+		return 0;
+	}
+
+	bzero((char *)&pm, sizeof(pm));
+	if (strcmp(argv[0], "off") == 0 && argc == 1) {
+		pm.pm_mode = SE_PM_OFF;
+	} else if (argc == 2 || argc == 3) {
+		val = strtol(argv[1], (char **)0, 0);
+		pm.pm_mode = SE_PM_BCAST;
+		if (argc == 3) {
+			if (strcmp(argv[2], "mcast") == 0) {
+				pm.pm_mode = SE_PM_NOTUCAST;
+			} else if (strcmp(argv[2], "bcast") != 0) {
+				usage();
+			}
+		}
+
+		/* The window starts at the destination address, so that it
+		 * fits in the shortest frames (see if_se.h) */
+		pm.pm_offset = 0;
+		if (strcmp(argv[0], "ethertype") == 0) {
+			setpm(&pm, 12, (val >> 8) & 0xff);
+			setpm(&pm, 13, val & 0xff);
+		} else if (strcmp(argv[0], "udpport") == 0) {
+			/* IP, with no options, UDP, destination port */
+			setpm(&pm, 12, 0x08);
+			setpm(&pm, 13, 0x00);
+			setpm(&pm, 14, 0x45);
+			setpm(&pm, 23, 17);
+			setpm(&pm, 36, (val >> 8) & 0xff);
+			setpm(&pm, 37, val & 0xff);
+		} else {
+			usage();
+		}
+	} else {
+		usage();
+	}
+
+	if (se_ioctl(s, ifname, SIOCSSEPMATCH, (caddr_t)&pm) < 0) {
+		perror(ifname);
+		return 1;
+	}
+	return 0;
+}
+
+/* Show or set the bond. argv holds the words after "bond". */
+int bond(s, ifname, argc, argv)
+int s;
+char *ifname;
+int argc;
+char **argv;
+{
+	struct se_bond sb;
+	int i;
+
+	if (argc == 0) {
+		if (se_ioctl(s, ifname, SIOCGSEBOND, (caddr_t)&sb) < 0) {
+			perror("bond");
+			return 1;
+		}
+		printf("bond master se%d members", sb.sb_master);
+		for (i = 0; i < 8 * sizeof(sb.sb_members); i++) {
+			if (sb.sb_members & (1 << i)) {
+				printf(" se%d%s", i,
+				       (sb.sb_active & (1 << i)) ? "" :
+								   "(down)");
+			}
+		}
+		printf("\n");
+		return 0;
+	}
+
+	sb.sb_members = 0;
+	if (!(argc == 1 && strcmp(argv[0], "off") == 0)) {
+		for (i = 0; i < argc; i++) {
+			if (strncmp(argv[i], "se", 2) != 0 ||
+			    argv[i][2] < '0' || argv[i][2] > '9') {
+				usage();
+			}
+			sb.sb_members |= 1 << atoi(argv[i] + 2);
+		}
+	}
+	if (se_ioctl(s, ifname, SIOCSSEBOND, (caddr_t)&sb) < 0) {
+		perror(ifname);
+		return 1;
+	}
+	return 0;
+}
+
+main(argc, argv)
+int argc;
+char **argv;
+{
+	struct paramname *p;
+	struct se_param sp;
+	int s, status = 0;
+	long strtol();
+
+	progname = argv[0];
+	if (argc < 2) {
+		usage();
+	}
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	if (s < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	if (argc > 2 && strcmp(argv[2], "pmatch") == 0) {
+		exit(pmatch(s, argv[1], argc - 3, argv + 3));
+	}
+	if (argc > 2 && strcmp(argv[2], "bond") == 0) {
+		exit(bond(s, argv[1], argc - 3, argv + 3));
+	}
+	if (argc > 4) {
+		usage();
+	}
+
+	if (argc == 2) {
+		for (p = params; p->name; p++) {
+			if (show(s, argv[1], p) < 0) {
+				status = 1;
+			}
+		}
+		if (pmatch(s, argv[1], 0, (char **)0)) {
+			status = 1;
+		}
+		exit(status);
+	}
+
+	for (p = params; p->name; p++) {
+		if (strcmp(p->name, argv[2]) == 0) {
+			break;
+		}
+	}
+	if (p->name == 0) {
+		fprintf(stderr, "%s: unknown parameter %s\n", progname,
+			argv[2]);
+		usage();
+	}
+
+	if (argc == 3) {
+		exit(show(s, argv[1], p) < 0);
+	}
+
+	sp.sp_param = p->param;
+	sp.sp_value = (int)strtol(argv[3], (char **)0, 0);
+	if (se_ioctl(s, argv[1], SIOCSSEPARAM, (caddr_t)&sp) < 0) {
+		perror(argv[1]);
+		exit(1);
+	}
+	exit(0);
+}
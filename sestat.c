@@ -0,0 +1,342 @@
+/* sestat - show SEthernet/30 driver statistics under A/UX
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: sestat [-z] interface [interval]
+ *        sestat -c [-z] interface
+ *        sestat -p [-z] interface
+ *        sestat -w [-z] interface
+ *
+ * With no interval, prints every counter once. With an interval (in seconds),
+ * prints a line of the main counters every interval, showing the change since
+ * the line before, in the manner of netstat -i. The first line is totals. -z
+ * zeroes the driver's counters after reading them (requires root).
+ *
+ * -c breaks the traffic down by class of frame (IP, ARP, 802.3 and other),
+ * including how many mbufs received frames took on average.
+ *
+ * -p shows the time spent in each stage of the driver, if it was built with
+ * SE_PROFILE.
+ *
+ * -w shows the flow control watermarks, and a histogram of how full the
+ * receive ring was at each interrupt.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include "if_se.h"
+
+/* Offset of a counter within struct se_stats */
+#define SS(field) ((int)&((struct se_stats *)0)->field)
+
+/* Value of the counter at offset off */
+#define VAL(st, off) (*(unsigned long *)((char *)(st) + (off)))
+
+struct counter {
+	char *name;
+	int off;
+	char *desc;
+};
+
+/* Every counter, for the long listing */
+struct counter counters[] = {
+	{ "ipackets", SS(ss_ipackets), "frames received" },
+	{ "ibytes", SS(ss_ibytes), "bytes received" },
+	{ "ierrors", SS(ss_ierrors), "receive errors" },
+	{ "rxabort", SS(ss_rxabort), "receive aborts (ring full)" },
+	{ "pcfull", SS(ss_pcfull), "packet counter overflows" },
+	{ "rxresets", SS(ss_rxresets), "receive ring resets" },
+	{ "rxresyncs", SS(ss_rxresyncs), "receive ring resyncs" },
+	{ "resyncdrops", SS(ss_resyncdrops), "frames lost to resyncs" },
+	{ "nombuf", SS(ss_nombuf), "frames lost for want of mbufs" },
+	{ "iqdrops", SS(ss_iqdrops), "protocol input queue overflows" },
+	{ "unwanted", SS(ss_unwanted), "frames dropped in ring, unwanted" },
+	{ "mcastmiss", SS(ss_mcastmiss),
+	  "frames dropped in ring, multicast not subscribed" },
+	{ "notme", SS(ss_notme),
+	  "frames dropped in ring, not to us (capturing)" },
+	{ "captured", SS(ss_captured), "frames passed to capture" },
+	{ "capbytes", SS(ss_capbytes), "bytes passed to capture" },
+	{ "rxintrs", SS(ss_rxintrs), "receive passes from interrupt" },
+	{ "rxintrframes", SS(ss_rxintr_frames),
+	  "frames received from interrupt" },
+	{ "rxpolls", SS(ss_rxpolls), "receive passes from poll" },
+	{ "rxpollframes", SS(ss_rxpoll_frames), "frames received from poll" },
+	{ "rxpollticks", SS(ss_rxpoll_ticks), "clock ticks spent polling" },
+	{ "poolmiss", SS(ss_poolmiss[0]), "small mbuf reserve empty" },
+	{ "clpoolmiss", SS(ss_poolmiss[1]), "cluster reserve empty" },
+	{ "poollow", SS(ss_poollow[0]), "small mbuf reserve low water" },
+	{ "clpoollow", SS(ss_poollow[1]), "cluster reserve low water" },
+	{ "opackets", SS(ss_opackets), "frames sent" },
+	{ "obytes", SS(ss_obytes), "bytes sent" },
+	{ "oerrors", SS(ss_oerrors), "transmit errors" },
+	{ "oqdrops", SS(ss_oqdrops), "send queue overflows" },
+	{ "collisions", SS(ss_collisions), "collisions" },
+	{ "deferred", SS(ss_deferred), "frames deferred" },
+	{ "exdefer", SS(ss_exdefer), "frames deferred too long" },
+	{ "latecol", SS(ss_latecol), "late collisions" },
+	{ "maxcol", SS(ss_maxcol), "frames aborted, too many collisions" },
+	{ "txintrs", SS(ss_txintrs), "transmit completions from interrupt" },
+	{ "txreaped", SS(ss_txreaped),
+	  "transmit completions reaped without one" },
+	{ 0, 0, 0 }
+};
+
+/* The counters shown by the interval display, and their column headings */
+struct counter brief[] = {
+	{ "ipkts", SS(ss_ipackets) },
+	{ "ibytes", SS(ss_ibytes) },
+	{ "ierrs", SS(ss_ierrors) },
+	{ "nombuf", SS(ss_nombuf) },
+	{ "iqdrop", SS(ss_iqdrops) },
+	{ "dropped", SS(ss_unwanted) },
+	{ "opkts", SS(ss_opackets) },
+	{ "obytes", SS(ss_obytes) },
+	{ "oerrs", SS(ss_oerrors) },
+	{ "oqdrop", SS(ss_oqdrops) },
+	{ "colls", SS(ss_collisions) },
+	{ 0, 0 }
+};
+
+char *profnames[] = SE_PROF_NAMES;
+char *classnames[] = SE_CLASS_NAMES;
+
+char *progname;
+int zero;
+
+usage()
+{
+	fprintf(stderr, "usage: %s [-z] interface [interval]\n", progname);
+	fprintf(stderr, "       %s -c [-z] interface\n", progname);
+	fprintf(stderr, "       %s -p [-z] interface\n", progname);
+	fprintf(stderr, "       %s -w [-z] interface\n", progname);
+	exit(1);
+}
+
+/* VIA timer ticks (at 783.36KHz) to microseconds */
+#define USEC(ticks) ((ticks) * 12766 / 10000)
+
+/* Show the profiling counters for the named interface */
+profile(s, ifname)
+int s;
+char *ifname;
+{
+	static struct se_prof prof;
+	register struct se_profstage *ps;
+	struct ifreq ifr;
+	int i, b;
+
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (caddr_t)&prof;
+	if (ioctl(s, zero ? SIOCZSEPROF : SIOCGSEPROF, (caddr_t)&ifr) < 0) {
+		perror(ifname);
+		fprintf(stderr, "(was the driver built with SE_PROFILE?)\n");
+		exit(1);
+	}
+
+	printf("%-8s %9s %9s %9s %9s   (times in us)\n", "stage", "count",
+	       "min", "avg", "max");
+	for (i = 0; i < SE_PROF_NSTAGES; i++) {
+		ps = &prof.sp_stage[i];
+		printf("%-8s %9lu %9lu %9lu %9lu\n", profnames[i],
+		       ps->ps_count, USEC(ps->ps_min),
+		       ps->ps_count ? USEC(ps->ps_sum / ps->ps_count) : 0,
+		       USEC(ps->ps_max));
+	}
+
+	printf("\nhistogram (us up to)");
+	for (i = 0; i < SE_PROF_NSTAGES; i++) {
+		printf(" %8s", profnames[i]);
+	}
+	printf("\n");
+	for (b = 0; b < SE_PROF_BUCKETS; b++) {
+		if (b == SE_PROF_BUCKETS - 1) {
+			printf("%20s", "longer");
+		} else {
+			printf("%20lu", USEC((1L << b) - 1));
+		}
+		for (i = 0; i < SE_PROF_NSTAGES; i++) {
+			printf(" %8lu", prof.sp_stage[i].ps_hist[b]);
+		}
+		printf("\n");
+	}
+}
+
+/* Show the receive ring occupancy histogram and flow control watermarks */
+watermarks(s, ifname)
+int s;
+char *ifname;
+{
+	struct se_rxwm wm;
+	struct ifreq ifr;
+	int b;
+
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (caddr_t)&wm;
+	if (ioctl(s, zero ? SIOCZSERXWM : SIOCGSERXWM, (caddr_t)&ifr) < 0) {
+		perror(ifname);
+		exit(1);
+	}
+
+	printf("ring %d bytes, high watermark %d, low watermark %d\n",
+	       wm.rw_size * 96, wm.rw_hwm * 96, wm.rw_lwm * 96);
+	printf("high watermark range %d-%d, raised %lu times, lowered %lu "
+	       "times\n", wm.rw_min * 96, wm.rw_max * 96, wm.rw_raises,
+	       wm.rw_lowers);
+	printf("\n%-14s %10s %6s\n", "occupancy", "samples", "%");
+	for (b = 0; b < SE_WMBUCKETS; b++) {
+		printf("%5d - %5d  %10lu %6.1f\n",
+		       wm.rw_size * 96 * b / SE_WMBUCKETS,
+		       wm.rw_size * 96 * (b + 1) / SE_WMBUCKETS,
+		       wm.rw_hist[b],
+		       wm.rw_samples ?
+			       100.0 * wm.rw_hist[b] / wm.rw_samples : 0.0);
+	}
+}
+
+/* Read the statistics for the named interface, zeroing them if asked to */
+getstats(s, ifname, st)
+int s;
+char *ifname;
+struct se_stats *st;
+{
+	struct ifreq ifr;
+
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (caddr_t)st;
+	if (ioctl(s, zero ? SIOCZSESTATS : SIOCGSESTATS, (caddr_t)&ifr) < 0) {
+		perror(ifname);
+		exit(1);
+	}
+}
+
+/* Show the statistics for each class of frame */
+classes(st)
+struct se_stats *st;
+{
+	register struct se_classstats *cs;
+	int i;
+
+	printf("%-6s %10s %12s %8s %10s %10s %12s\n", "class", "ipkts",
+	       "ibytes", "mbufs/f", "idrops", "opkts", "obytes");
+	for (i = 0; i < SE_NCLASSES; i++) {
+		cs = &st->ss_class[i];
+		printf("%-6s %10lu %12lu %8.2f %10lu %10lu %12lu\n",
+		       classnames[i], cs->cs_ipackets, cs->cs_ibytes,
+		       cs->cs_ipackets > cs->cs_idrops ?
+			       (double)cs->cs_imbufs /
+				       (cs->cs_ipackets - cs->cs_idrops) : 0.0,
+		       cs->cs_idrops, cs->cs_opackets, cs->cs_obytes);
+	}
+}
+
+/* Print the interval display headings */
+heading()
+{
+	struct counter *c;
+
+	for (c = brief; c->name; c++) {
+		printf("%10s", c->name);
+	}
+	printf("\n");
+}
+
+main(argc, argv)
+int argc;
+char **argv;
+{
+	struct se_stats st, prev;
+	struct counter *c;
+	char *ifname;
+	int s, interval = 0, lines = 0, prof = 0, class = 0, wmark = 0;
+
+	progname = argv[0];
+	argv++;
+	argc--;
+	while (argc > 0 && argv[0][0] == '-') {
+		if (strcmp(argv[0], "-z") == 0) {
+			zero = 1;
+		} else if (strcmp(argv[0], "-p") == 0) {
+			prof = 1;
+		} else if (strcmp(argv[0], "-c") == 0) {
+			class = 1;
+		} else if (strcmp(argv[0], "-w") == 0) {
+			wmark = 1;
+		} else {
+			usage();
+		}
+		argv++;
+		argc--;
+	}
+	if (argc < 1 || argc > 2) {
+		usage();
+	}
+	ifname = argv[0];
+	if (argc == 2) {
+		if (prof || class || wmark) {
+			usage();
+		}
+		interval = atoi(argv[1]);
+		if (interval <= 0) {
+			usage();
+		}
+	}
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	if (s < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	if (prof) {
+		profile(s, ifname);
+		exit(0);
+	}
+
+	if (wmark) {
+		watermarks(s, ifname);
+		exit(0);
+	}
+
+	if (class) {
+		getstats(s, ifname, &st);
+		classes(&st);
+		exit(0);
+	}
+
+	if (interval == 0) {
+		getstats(s, ifname, &st);
+		for (c = counters; c->name; c++) {
+			printf("%-14s%12lu  %s\n", c->name, VAL(&st, c->off),
+			       c->desc);
+		}
+		exit(0);
+	}
+
+	/* With -z, each read zeroes the counters, so every line is a delta
+	 * already. Otherwise, subtract the previous reading. */
+	bzero((char *)&prev, sizeof(prev));
+	for (;;) {
+		if (lines++ % 20 == 0) {
+			heading();
+		}
+		getstats(s, ifname, &st);
+		for (c = brief; c->name; c++) {
+			printf("%10lu", VAL(&st, c->off) - VAL(&prev, c->off));
+		}
+		printf("\n");
+		fflush(stdout);
+		prev = st;
+		if (zero) {
+			/* the interface counters aren't zeroed */
+			bzero((char *)&prev + SS(ss_ibytes),
+			      sizeof(prev) - SS(ss_ibytes));
+		}
+		sleep(interval);
+	}
+}
@@ -0,0 +1,253 @@
+/* setrace - dump the SEthernet/30 driver's event trace under A/UX
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: setrace [-r] [-z] interface
+ *
+ * Prints the events in the driver's trace ring, oldest first, with times in
+ * clock ticks relative to the first one shown. -z empties the ring afterwards
+ * (requires root). Tracing is turned on and off with "seconfig interface trace
+ * 1" and "seconfig interface trace 0".
+ *
+ * -r prints the driver's register access log instead, if it was built with
+ * ENC624J600_REGTRACE, followed by a count of accesses to each register. Each
+ * access is printed as slot, R or W, register offset and value (as it appeared
+ * on the bus, so pointers and counts are byte-swapped), then the register's
+ * name, which makes the log easy to diff or feed to other tools. To see what a
+ * particular operation costs, empty the log with -r -z, do it, and then look.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include "if_se.h"
+
+char *classnames[] = SE_CLASS_NAMES;
+char *dropnames[] = { "unwanted", "mcast", "nombuf", "notme" };
+
+/* Register names for the access log. The set-bit and clear-bit registers are
+ * at 0x100 and 0x180 above the registers they act on. */
+struct regname {
+	unsigned short reg;
+	char *name;
+};
+
+#define R(reg) { reg, #reg }
+
+struct regname regnames[] = {
+	R(ETXST), R(ETXLEN), R(ERXST), R(ERXTAIL), R(ERXHEAD), R(EDMAST),
+	R(EDMALEN), R(EDMADST), R(EDMACS), R(ETXSTAT), R(ETXWIRE), R(EUDAST),
+	R(EUDAND), R(ESTAT), R(EIR), R(ECON1), R(EHT1), R(EHT2), R(EHT3),
+	R(EHT4), R(EPMM1), R(EPMM2), R(EPMM3), R(EPMM4), R(EPMCS), R(EPMOL),
+	R(ERXFCON), R(MACON1), R(MACON2), R(MABBIPG), R(MAIPG), R(MACLCON),
+	R(MAMXFLL), R(MICMD), R(MIREGADR), R(MAADR3), R(MAADR2), R(MAADR1),
+	R(MIWR), R(MIRD), R(MISTAT), R(EPAUS), R(ECON2), R(ERXWM), R(EIE),
+	R(EIDLED), R(EGPDATA), R(ERXDATA), R(EUDADATA), R(EGPRDPT),
+	R(EGPWRPT), R(ERXRDPT), R(ERXWRPT), R(EUDARDPT), R(EUDAWRPT),
+	{ 0, 0 }
+};
+
+char *progname;
+
+usage()
+{
+	fprintf(stderr, "usage: %s [-r] [-z] interface\n", progname);
+	exit(1);
+}
+
+/* Name a register offset, in a static buffer */
+char *regname(reg)
+unsigned short reg;
+{
+	static char buf[32];
+	struct regname *r;
+	char *suffix = "";
+
+	if (reg >= ENC624J600_CLEAR_BIT_REGISTER_OFFSET + 0x7e00) {
+		reg -= ENC624J600_CLEAR_BIT_REGISTER_OFFSET;
+		suffix = "CLR";
+	} else if (reg >= ENC624J600_SET_BIT_REGISTER_OFFSET + 0x7e00) {
+		reg -= ENC624J600_SET_BIT_REGISTER_OFFSET;
+		suffix = "SET";
+	}
+	for (r = regnames; r->name; r++) {
+		if (r->reg == reg) {
+			sprintf(buf, "%s%s", r->name, suffix);
+			return buf;
+		}
+	}
+	sprintf(buf, "%04x%s", reg, suffix);
+	return buf;
+}
+
+/* Fetch and print the register access log */
+regtrace(s, ifname, zero)
+int s;
+char *ifname;
+int zero;
+{
+	static struct se_regtrace rt;
+	static unsigned long reads[0x200], writes[0x200];
+	register struct se_regrec *rr;
+	struct ifreq ifr;
+	unsigned long i, first;
+	int r;
+
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (caddr_t)&rt;
+	if (ioctl(s, zero ? SIOCZSEREGTRACE : SIOCGSEREGTRACE,
+		  (caddr_t)&ifr) < 0) {
+		perror(ifname);
+		fprintf(stderr,
+			"(was the driver built with ENC624J600_REGTRACE?)\n");
+		exit(1);
+	}
+
+	first = 0;
+	if (rt.rt_next > SE_REGTRACELEN) {
+		first = rt.rt_next - SE_REGTRACELEN;
+		printf("(%lu earlier accesses lost)\n", first);
+	}
+	for (i = first; i < rt.rt_next; i++) {
+		rr = &rt.rt_rec[i % SE_REGTRACELEN];
+		printf("%x %c %04x %04x  %s\n", rr->rr_slot,
+		       rr->rr_write ? 'W' : 'R', rr->rr_reg, rr->rr_value,
+		       regname(rr->rr_reg));
+		if (rr->rr_reg >= 0x7e00) {
+			if (rr->rr_write) {
+				writes[rr->rr_reg - 0x7e00]++;
+			} else {
+				reads[rr->rr_reg - 0x7e00]++;
+			}
+		}
+	}
+
+	printf("\n%-12s %8s %8s\n", "register", "reads", "writes");
+	for (r = 0; r < 0x200; r++) {
+		if (reads[r] || writes[r]) {
+			printf("%-12s %8lu %8lu\n", regname(r + 0x7e00),
+			       reads[r], writes[r]);
+		}
+	}
+	printf("%-12s %8lu\n", "total", rt.rt_next - first);
+}
+
+/* Print one event */
+show(tr, t0)
+register struct se_tracerec *tr;
+unsigned long t0;
+{
+	printf("%8lu  ", tr->tr_time - t0);
+	switch (tr->tr_event) {
+	case SE_TR_INTR:
+		printf("intr     eir %04x\n", tr->tr_a);
+		break;
+	case SE_TR_RXDRAIN:
+		printf("rxdrain  %s, %d waiting, %d taken\n",
+		       tr->tr_c ? "polled" : "interrupt", tr->tr_a, tr->tr_b);
+		break;
+	case SE_TR_RXPKT:
+		printf("rxpkt    %s at %04x, next %04x\n",
+		       tr->tr_c < SE_NCLASSES ? classnames[tr->tr_c] : "?",
+		       tr->tr_a, tr->tr_b);
+		break;
+	case SE_TR_RXDROP:
+		printf("rxdrop   %s at %04x, %d bytes\n",
+		       tr->tr_c < 4 ? dropnames[tr->tr_c] : "?", tr->tr_a,
+		       tr->tr_b);
+		break;
+	case SE_TR_RXFLUSH:
+		printf("rxflush  ipintrq %d, etintrq %d\n", tr->tr_a, tr->tr_b);
+		break;
+	case SE_TR_TXSTART:
+		printf("txstart  slot %d, %d bytes, %d staged\n", tr->tr_c,
+		       tr->tr_a, tr->tr_b);
+		break;
+	case SE_TR_TXDONE:
+		printf("txdone   slot %d, etxstat %04x, eir %04x\n", tr->tr_c,
+		       tr->tr_a, tr->tr_b);
+		break;
+	case SE_TR_OUTPUT:
+		printf("output   send queue %d\n", tr->tr_a);
+		break;
+	case SE_TR_RESET:
+		printf("reset    rxptr %04x, %d recent resets\n", tr->tr_a,
+		       tr->tr_b);
+		break;
+	case SE_TR_NOMBUF:
+		printf("nombuf   %s\n", tr->tr_c ? "cluster" : "mbuf");
+		break;
+	case SE_TR_LINK:
+		printf("link     estat %04x\n", tr->tr_a);
+		break;
+	case SE_TR_RESYNC:
+		printf("resync   rxptr %04x, %d dropped\n", tr->tr_a, tr->tr_b);
+		break;
+	default:
+		printf("event %d: %02x %04x %04x\n", tr->tr_event, tr->tr_c,
+		       tr->tr_a, tr->tr_b);
+		break;
+	}
+}
+
+main(argc, argv)
+int argc;
+char **argv;
+{
+	static struct se_trace trace;
+	struct ifreq ifr;
+	unsigned long i, first;
+	int s, zero = 0, regs = 0;
+
+	progname = argv[0];
+	while (argc > 2 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-z") == 0) {
+			zero = 1;
+		} else if (strcmp(argv[1], "-r") == 0) {
+			regs = 1;
+		} else {
+			usage();
+		}
+		argv++;
+		argc--;
+	}
+	if (argc != 2) {
+		usage();
+	}
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	if (s < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	if (regs) {
+		regtrace(s, argv[1], zero);
+		exit(0);
+	}
+
+	strncpy(ifr.ifr_name, argv[1], sizeof(ifr.ifr_name));
+	ifr.ifr_data = (caddr_t)&trace;
+	if (ioctl(s, zero ? SIOCZSETRACE : SIOCGSETRACE, (caddr_t)&ifr) < 0) {
+		perror(argv[1]);
+		exit(1);
+	}
+
+	/* The driver may have been adding events while the ring was copied
+	 * out, so skip the oldest few, which might have been overwritten by
+	 * then */
+	first = 0;
+	if (trace.st_next > SE_TRACELEN) {
+		first = trace.st_next - SE_TRACELEN + 8;
+		printf("(%lu earlier events lost)\n", first);
+	}
+	for (i = first; i < trace.st_next; i++) {
+		show(&trace.st_rec[i % SE_TRACELEN],
+		     trace.st_rec[first % SE_TRACELEN].tr_time);
+	}
+	exit(0);
+}
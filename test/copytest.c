@@ -0,0 +1,210 @@
+/* copytest - check se_copy() against a plain longword copy, and time the two
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: copytest [-n iterations] [-r copies] [-s seed]
+ *
+ * se_copy() is internal to the driver, so this includes the driver's source
+ * to get at it. Every combination of source and destination alignment (mod 4)
+ * is tried with every length up to 300 and a few up to a full frame, and then
+ * copies of random lengths between random offsets (mod 8) in the buffers. Each
+ * result is compared with lcopy()'s, including the bytes either side of the
+ * destination, which must not be touched. Exits nonzero if any differ. The
+ * random copies are different each run unless -s gives a seed; the seed is
+ * printed, so a failing run can be repeated.
+ *
+ * Then each size of copy is timed both ways, with the source aligned and odd.
+ * lcopy() is the obvious way to do better than a byte loop: bytes until the
+ * source is on a longword boundary, then longwords, then bytes. That's the
+ * least a copy routine on the packet path should manage, so it's what se_copy()
+ * has to beat, rather than the harness's bcopy(), which moves a byte at a time
+ * as the A/UX one does. The times are for the host, so only the ratio between
+ * the two means anything, and not much even then: the host has no 16-bit bus
+ * in the way, and doesn't mind misaligned longwords nearly as much as a 68030.
+ */
+
+#include "../if_se.c"
+
+#include "host.h"
+
+#define GUARD 8
+#define MAXLEN (ETHERMTU + sizeof(struct ether_header))
+
+unsigned char srcbuf[MAXLEN + 2 * GUARD];
+unsigned char dstbuf[MAXLEN + 2 * GUARD];
+unsigned char refbuf[MAXLEN + 2 * GUARD];
+
+int bigsizes[] = { 511, 512, 513, 1023, 1024, 1025, 1513, 1514 };
+int timesizes[] = { 14, 60, 64, 128, 512, 1024, 1514 };
+
+#define NELEM(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+unsigned int seed;
+
+/* Next pseudo-random number (xorshift32). Good enough to pick lengths and
+ * offsets, and the same on every host for a given seed. */
+unsigned int rnd()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* The reference copy: bytes to get the source onto a longword boundary, then
+ * longwords, then the remaining bytes */
+void lcopy(src, dst, len)
+register unsigned char *src;
+register unsigned char *dst;
+register unsigned len;
+{
+	register unsigned long *ls, *ld;
+
+	while (len && ((caddr_t)src - (caddr_t)0) & 3) {
+		*dst++ = *src++;
+		len--;
+	}
+	ls = (unsigned long *)src;
+	ld = (unsigned long *)dst;
+	for (; len >= 4; len -= 4) {
+		*ld++ = *ls++;
+	}
+	src = (unsigned char *)ls;
+	dst = (unsigned char *)ld;
+	while (len--) {
+		*dst++ = *src++;
+	}
+}
+
+/* Copy len bytes with se_copy() and lcopy(), with the source and destination
+ * soff and doff bytes into their buffers, and compare. Returns 1 if they
+ * match. */
+int trycopy(soff, doff, len)
+int soff;
+int doff;
+int len;
+{
+	register int i;
+
+	for (i = 0; i < (int)sizeof(srcbuf); i++) {
+		srcbuf[i] = i * 7 + len;
+		dstbuf[i] = refbuf[i] = ~i;
+	}
+	se_copy(srcbuf + GUARD + soff, dstbuf + GUARD + doff, len);
+	lcopy(srcbuf + GUARD + soff, refbuf + GUARD + doff, len);
+	if (bcmp((caddr_t)dstbuf, (caddr_t)refbuf, sizeof(dstbuf)) == 0) {
+		return 1;
+	}
+	for (i = 0; dstbuf[i] == refbuf[i]; i++);
+	host_print("FAIL: src+%d dst+%d len %d: differs at dst+%d\n", soff,
+		   doff, len, i - GUARD - doff);
+	return 0;
+}
+
+int check(ncopies)
+int ncopies;
+{
+	int soff, doff, len, i, failed = 0, n = 0;
+
+	for (soff = 0; soff < 4; soff++) {
+		for (doff = 0; doff < 4; doff++) {
+			for (len = 0; len <= 300; len++) {
+				failed += !trycopy(soff, doff, len);
+				n++;
+			}
+			for (i = 0; i < NELEM(bigsizes); i++) {
+				failed += !trycopy(soff, doff, bigsizes[i]);
+				n++;
+			}
+		}
+	}
+	host_print("copytest: seed %u\n", seed);
+	for (i = 0; i < ncopies; i++) {
+		soff = rnd() % GUARD;
+		doff = rnd() % GUARD;
+		len = rnd() % (MAXLEN + 1);
+		failed += !trycopy(soff, doff, len);
+		n++;
+	}
+	host_print("copytest: %d copies checked, %d failed\n", n, failed);
+	return failed;
+}
+
+/* Nanoseconds per copy of len bytes, by whichever routine */
+double timecopy(se, soff, len, iters)
+int se;
+int soff;
+int len;
+int iters;
+{
+	register int i;
+	unsigned char *src = srcbuf + GUARD + soff, *dst = dstbuf + GUARD;
+	double t0;
+
+	t0 = host_time();
+	if (se) {
+		for (i = 0; i < iters; i++) {
+			se_copy(src, dst, len);
+		}
+	} else {
+		for (i = 0; i < iters; i++) {
+			lcopy(src, dst, len);
+		}
+	}
+	return (host_time() - t0) * 1e9 / iters;
+}
+
+void bench(iters)
+int iters;
+{
+	int i, soff, len;
+	double tse, tl;
+
+	host_print("%6s %4s %10s %10s %6s\n", "len", "src", "se_copy", "lcopy",
+		   "ratio");
+	for (i = 0; i < NELEM(timesizes); i++) {
+		len = timesizes[i];
+		for (soff = 0; soff < 2; soff++) {
+			tse = timecopy(1, soff, len, iters);
+			tl = timecopy(0, soff, len, iters);
+			host_print("%6d %4s %8.1fns %8.1fns %6.2f\n", len,
+				   soff ? "odd" : "even", tse, tl, tl / tse);
+		}
+	}
+}
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	int iters = 100000, ncopies = 100000;
+
+	for (argc--, argv++; argc >= 2 && argv[0][0] == '-'; argc -= 2,
+	     argv += 2) {
+		switch (argv[0][1]) {
+		case 'n':
+			iters = host_atoi(argv[1]);
+			continue;
+		case 'r':
+			ncopies = host_atoi(argv[1]);
+			continue;
+		case 's':
+			seed = host_atoi(argv[1]);
+			continue;
+		}
+		break;
+	}
+	if (argc != 0) {
+		host_print("usage: copytest [-n iterations] [-r copies] "
+			   "[-s seed]\n");
+		host_exit(2);
+	}
+	if (seed == 0) {
+		seed = (unsigned int)(host_time() * 1e6) | 1;
+	}
+	if (check(ncopies)) {
+		host_exit(1);
+	}
+	bench(iters);
+	return 0;
+}
@@ -0,0 +1,677 @@
+/* A software model of the ENC624J600 (see enc624j600_sim.h)
+ *
+ * Copyright 2024, Richard Halkyard
+ */
+
+#include "enc624j600_registers.h"
+#include "enc624j600_sim.h"
+#include "host.h"
+
+/* A register, by its address */
+#define REG(card, reg) ((card)->regs[((reg) - ENC_REGBASE) >> 1])
+
+/* A pointer register, as the chip sees it */
+#define PTR(card, reg) SWAPBYTES(REG(card, reg))
+
+/* Frames shorter than this are padded by the sender, and longer ones are
+ * dropped; both without the CRC */
+#define ENC_MINFRAME 60
+#define ENC_MAXFRAME 1514
+
+struct enc_card enc_cards[16];
+int enc_log;
+
+static void enc_reset();
+static void enc_store();
+static void enc_transmit();
+static void enc_dma();
+static int enc_filter();
+static int enc_hashmatch();
+static int enc_pmatch();
+static unsigned long enc_crc();
+static void enc_ringput();
+static void enc_logaccess();
+
+/* Put a card in a slot, fresh from power-on, with a link */
+struct enc_card *enc_attach(slot, mac)
+int slot;
+unsigned char *mac;
+{
+	struct enc_card *card = &enc_cards[slot];
+	int i;
+
+	card->present = 1;
+	card->slot = slot;
+	for (i = 0; i < 6; i++) {
+		card->mac[i] = mac[i];
+	}
+	card->link = 1;
+	card->fdx = 1;
+	card->txstall = 0;
+	card->txhook = 0;
+	enc_reset(card);
+	return card;
+}
+
+/* The card at a base address, or 0 if there isn't one there */
+struct enc_card *enc_lookup(base)
+unsigned char *base;
+{
+	int slot;
+
+	for (slot = 0; slot < 16; slot++) {
+		if (base == enc_cards[slot].mem) {
+			return enc_cards[slot].present ? &enc_cards[slot] : 0;
+		}
+	}
+	return 0;
+}
+
+unsigned char *enc_base(slot)
+int slot;
+{
+	return enc_cards[slot & 0xf].mem;
+}
+
+/* Put the registers into their reset state. Buffer memory is left alone, as
+ * it is by the chip. */
+static void enc_reset(card)
+struct enc_card *card;
+{
+	int i;
+
+	for (i = 0; i < ENC_NREGS; i++) {
+		card->regs[i] = 0;
+	}
+	card->pktcnt = 0;
+	REG(card, ERXST) = SWAPBYTES(0x5340);
+	REG(card, ERXHEAD) = SWAPBYTES(0x5340);
+	REG(card, ERXTAIL) = SWAPBYTES(0x5ffe);
+	REG(card, ECON2) = SWAPBYTES(0xcb00);
+
+	/* The address is read a byte at a time into ac_enaddr */
+	((unsigned char *)&REG(card, MAADR1))[0] = card->mac[0];
+	((unsigned char *)&REG(card, MAADR1))[1] = card->mac[1];
+	((unsigned char *)&REG(card, MAADR2))[0] = card->mac[2];
+	((unsigned char *)&REG(card, MAADR2))[1] = card->mac[3];
+	((unsigned char *)&REG(card, MAADR3))[0] = card->mac[4];
+	((unsigned char *)&REG(card, MAADR3))[1] = card->mac[5];
+}
+
+/* The interrupt flags, with PKTIF following the packet counter */
+static unsigned short enc_eir(card)
+struct enc_card *card;
+{
+	if (card->pktcnt) {
+		REG(card, EIR) |= EIR_PKTIF;
+	} else {
+		REG(card, EIR) &= ~EIR_PKTIF;
+	}
+	return REG(card, EIR);
+}
+
+/* Is the card's interrupt line asserted? */
+int enc_irq(card)
+struct enc_card *card;
+{
+	unsigned short eie = REG(card, EIE);
+
+	return (eie & EIE_INTIE) && (enc_eir(card) & eie & ~EIE_INTIE);
+}
+
+/* Read a register without side effects or counting it, for the harness */
+unsigned short enc_peek(card, reg)
+struct enc_card *card;
+int reg;
+{
+	if (reg == ESTAT) {
+		return (card->pktcnt << ESTAT_PKTCNT_SHIFT) |
+		       (enc_irq(card) ? ESTAT_INT : 0) | ESTAT_FCIDLE |
+		       ESTAT_CLKRDY | (card->fdx ? ESTAT_PHYDPX : 0) |
+		       (card->link ? ESTAT_PHYLNK : 0);
+	}
+	if (reg == EIR) {
+		return enc_eir(card);
+	}
+	return REG(card, reg);
+}
+
+/*
+Converting register values between the model and the bus. The driver copies the
+address registers straight into ac_enaddr, so the model keeps them in memory
+order; on a little-endian host that makes them the other way round from what a
+68k reads. Everything else is the same. The conversion is its own inverse.
+*/
+unsigned short enc_busval(reg, value)
+int reg;
+int value;
+{
+	value &= 0xffff;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (reg >= ENC_REGBASE + ENC624J600_SET_BIT_REGISTER_OFFSET) {
+		reg = ENC_REGBASE + ((reg - ENC_REGBASE) & 0xff);
+	}
+	if (reg == MAADR1 || reg == MAADR2 || reg == MAADR3) {
+		return SWAPBYTES(value);
+	}
+#endif
+	return value;
+}
+
+/* Register names, as setrace prints them */
+struct enc_regname {
+	unsigned short reg;
+	char *name;
+};
+
+#define R(reg) { reg, #reg }
+
+static struct enc_regname enc_regnames[] = {
+	R(ETXST), R(ETXLEN), R(ERXST), R(ERXTAIL), R(ERXHEAD), R(EDMAST),
+	R(EDMALEN), R(EDMADST), R(EDMACS), R(ETXSTAT), R(ETXWIRE), R(EUDAST),
+	R(EUDAND), R(ESTAT), R(EIR), R(ECON1), R(EHT1), R(EHT2), R(EHT3),
+	R(EHT4), R(EPMM1), R(EPMM2), R(EPMM3), R(EPMM4), R(EPMCS), R(EPMOL),
+	R(ERXFCON), R(MACON1), R(MACON2), R(MABBIPG), R(MAIPG), R(MACLCON),
+	R(MAMXFLL), R(MICMD), R(MIREGADR), R(MAADR3), R(MAADR2), R(MAADR1),
+	R(MIWR), R(MIRD), R(MISTAT), R(EPAUS), R(ECON2), R(ERXWM), R(EIE),
+	R(EIDLED), R(EGPDATA), R(ERXDATA), R(EUDADATA), R(EGPRDPT),
+	R(EGPWRPT), R(ERXRDPT), R(ERXWRPT), R(EUDARDPT), R(EUDAWRPT),
+	{ 0, 0 }
+};
+
+/* Name a register, in a static buffer */
+char *enc_regname(reg)
+int reg;
+{
+	static char buf[32];
+	struct enc_regname *r;
+	char *suffix = "";
+	char *p, *q;
+	int i;
+
+	if (reg >= ENC_REGBASE + ENC624J600_CLEAR_BIT_REGISTER_OFFSET) {
+		reg -= ENC624J600_CLEAR_BIT_REGISTER_OFFSET;
+		suffix = "CLR";
+	} else if (reg >= ENC_REGBASE + ENC624J600_SET_BIT_REGISTER_OFFSET) {
+		reg -= ENC624J600_SET_BIT_REGISTER_OFFSET;
+		suffix = "SET";
+	}
+	for (r = enc_regnames; r->name; r++) {
+		if (r->reg == reg) {
+			break;
+		}
+	}
+	p = buf;
+	if (r->name) {
+		for (q = r->name; *q; ) {
+			*p++ = *q++;
+		}
+	} else {
+		for (i = 12; i >= 0; i -= 4) {
+			*p++ = "0123456789abcdef"[(reg >> i) & 0xf];
+		}
+	}
+	for (q = suffix; *q; ) {
+		*p++ = *q++;
+	}
+	*p = 0;
+	return buf;
+}
+
+/* With enc_log set, print an access as setrace -r does */
+static void enc_logaccess(card, write, reg, value)
+struct enc_card *card;
+int write;
+int reg;
+int value;
+{
+	if (enc_log) {
+		host_print("%x %c %04x %04x  %s\n", card->slot,
+			   write ? 'W' : 'R', reg, enc_busval(reg, value),
+			   enc_regname(reg));
+	}
+}
+
+unsigned short enc_read(base, reg)
+unsigned char *base;
+int reg;
+{
+	struct enc_card *card = enc_lookup(base);
+	unsigned short value;
+
+	if (card == 0) {
+		host_panic("enc_read: no card there");
+	}
+	if (reg < ENC_REGBASE || reg >= ENC_REGBASE + 2 * ENC_NREGS ||
+	    reg & 1) {
+		host_print("enc_read: register %x\n", reg);
+		host_panic("enc_read: not a register");
+	}
+	card->nreads++;
+	value = enc_peek(card, reg);
+	enc_logaccess(card, 0, reg, value);
+	return value;
+}
+
+void enc_write(base, reg, value)
+unsigned char *base;
+int reg;
+int value;
+{
+	struct enc_card *card = enc_lookup(base);
+	unsigned short old;
+
+	if (card == 0) {
+		host_panic("enc_write: no card there");
+	}
+	card->nwrites++;
+	value &= 0xffff;
+	enc_logaccess(card, 1, reg, value);
+	if (reg >= ENC_REGBASE + ENC624J600_CLEAR_BIT_REGISTER_OFFSET) {
+		reg -= ENC624J600_CLEAR_BIT_REGISTER_OFFSET;
+		old = enc_peek(card, reg);
+		value = old & ~value;
+	} else if (reg >= ENC_REGBASE + ENC624J600_SET_BIT_REGISTER_OFFSET) {
+		reg -= ENC624J600_SET_BIT_REGISTER_OFFSET;
+		old = enc_peek(card, reg);
+		value = old | value;
+	} else {
+		old = enc_peek(card, reg);
+	}
+	if (reg < ENC_REGBASE || reg >= ENC_REGBASE + 2 * ENC_NREGS ||
+	    reg & 1) {
+		host_print("enc_write: register %x\n", reg);
+		host_panic("enc_write: not a register");
+	}
+	enc_store(card, reg, old, value);
+}
+
+/* Carry out a register write */
+static void enc_store(card, reg, old, value)
+struct enc_card *card;
+int reg;
+unsigned short old;
+unsigned short value;
+{
+	switch (reg) {
+	case ESTAT:
+	case ERXHEAD:
+	case ETXSTAT:
+		/* read-only */
+		return;
+	case EIR:
+		/* PKTIF can't be cleared, except by emptying the ring */
+		REG(card, EIR) = value;
+		return;
+	case ERXST:
+		/* The chip starts filling a new ring from the start */
+		REG(card, ERXST) = value;
+		REG(card, ERXHEAD) = value;
+		return;
+	case ECON2:
+		if (value & ECON2_ETHRST) {
+			enc_reset(card);
+		} else {
+			REG(card, ECON2) = value;
+		}
+		return;
+	case ECON1:
+		if (value & ECON1_PKTDEC) {
+			if (card->pktcnt > 0) {
+				card->pktcnt--;
+			}
+			value &= ~ECON1_PKTDEC;
+		}
+		REG(card, ECON1) = value;
+		if ((value & ECON1_TXRTS) && !(old & ECON1_TXRTS)) {
+			enc_transmit(card);
+		}
+		if ((value & ECON1_DMAST) && !(old & ECON1_DMAST)) {
+			enc_dma(card);
+		}
+		return;
+	}
+	REG(card, reg) = value;
+}
+
+/* Start sending the frame described by ETXST and ETXLEN */
+static void enc_transmit(card)
+struct enc_card *card;
+{
+	if (card->txstall) {
+		/* TXRTS stays set until the driver gives up and clears it,
+		 * or the harness calls enc_txfinish() */
+		return;
+	}
+	enc_txfinish(card);
+}
+
+/* Finish sending a frame: hand it over and set TXIF */
+void enc_txfinish(card)
+struct enc_card *card;
+{
+	unsigned short st = PTR(card, ETXST);
+	unsigned short len = PTR(card, ETXLEN);
+
+	if (!(REG(card, ECON1) & ECON1_TXRTS)) {
+		return;
+	}
+	if (st + len > ENC_MEMSIZE) {
+		host_print("enc: transmit of %d bytes at %x\n", len, st);
+		host_panic("enc: transmit runs off the end of memory");
+	}
+	card->ntx++;
+	if (card->txhook) {
+		(*card->txhook)(card, card->mem + st, len);
+	}
+	REG(card, ETXSTAT) = 0;
+	REG(card, ECON1) &= ~ECON1_TXRTS;
+	REG(card, EIR) |= EIR_TXIF;
+}
+
+/* Run the DMA engine. Only checksumming is modelled. The result is the
+ * complemented ones'-complement sum of the data taken as big-endian words, as
+ * for an IP header, carrying on from the complement of EDMACS if DMACSSD is
+ * set. */
+static void enc_dma(card)
+struct enc_card *card;
+{
+	unsigned short st = PTR(card, EDMAST);
+	unsigned short len = PTR(card, EDMALEN);
+	unsigned long sum = 0;
+	int i;
+
+	if (REG(card, ECON1) & (ECON1_DMACPY | ECON1_DMANOCS)) {
+		host_panic("enc: only DMA checksums are modelled");
+	}
+	if (st + len > ENC_MEMSIZE) {
+		host_print("enc: DMA of %d bytes at %x\n", len, st);
+		host_panic("enc: DMA runs off the end of memory");
+	}
+	if (REG(card, ECON1) & ECON1_DMACSSD) {
+		sum = ~REG(card, EDMACS) & 0xffff;
+	}
+	for (i = 0; i + 1 < len; i += 2) {
+		sum += (card->mem[st + i] << 8) | card->mem[st + i + 1];
+	}
+	if (len & 1) {
+		sum += card->mem[st + len - 1] << 8;
+	}
+	while (sum >> 16) {
+		sum = (sum >> 16) + (sum & 0xffff);
+	}
+	REG(card, EDMACS) = ~sum & 0xffff;
+	REG(card, ECON1) &= ~ECON1_DMAST;
+	REG(card, EIR) |= EIR_DMAIF;
+	card->ndma++;
+}
+
+/* Change the link state, as the PHY would on (re)negotiating */
+void enc_setlink(card, up, fdx)
+struct enc_card *card;
+int up;
+int fdx;
+{
+	card->link = up;
+	card->fdx = fdx;
+	REG(card, EIR) |= EIR_LINKIF;
+}
+
+/* A frame arrives off the wire (without its CRC). Returns 1 if it was put in
+ * the receive ring, 0 if it was filtered out or dropped. */
+int enc_rx(card, frame, len)
+struct enc_card *card;
+unsigned char *frame;
+int len;
+{
+	unsigned char pad[ENC_MINFRAME];
+	unsigned char hdr[8];
+	unsigned short start, head, tail, next, v;
+	unsigned long crc;
+	int i, ringsize, room, need, wirelen;
+
+	if (len < ENC_MINFRAME) {
+		for (i = 0; i < ENC_MINFRAME; i++) {
+			pad[i] = i < len ? frame[i] : 0;
+		}
+		frame = pad;
+		len = ENC_MINFRAME;
+	}
+	if (!(REG(card, ECON1) & ECON1_RXEN) || !card->link ||
+	    len > ENC_MAXFRAME || !enc_filter(card, frame, len)) {
+		card->nrxfilt++;
+		return 0;
+	}
+	wirelen = len + 4;
+
+	/* There has to be room for the frame (padded to even length) and its
+	 * header, short of ERXTAIL */
+	start = PTR(card, ERXST);
+	head = PTR(card, ERXHEAD);
+	tail = PTR(card, ERXTAIL);
+	ringsize = ENC_MEMSIZE - start;
+	need = sizeof(hdr) + wirelen + (wirelen & 1);
+	room = tail >= head ? tail - head : ringsize - (head - tail);
+	if (card->pktcnt == 255) {
+		REG(card, EIR) |= EIR_PCFULIF;
+		card->nrxabort++;
+		return 0;
+	}
+	if (need >= room) {
+		REG(card, EIR) |= EIR_RXABTIF;
+		card->nrxabort++;
+		return 0;
+	}
+	next = head + need;
+	if (next >= ENC_MEMSIZE) {
+		next -= ringsize;
+	}
+
+	/* Header: next-packet pointer and receive status vector */
+	v = SWAPBYTES(next);
+	hdr[0] = ((unsigned char *)&v)[0];
+	hdr[1] = ((unsigned char *)&v)[1];
+	v = SWAPBYTES(wirelen);
+	hdr[2] = ((unsigned char *)&v)[0];
+	hdr[3] = ((unsigned char *)&v)[1];
+	hdr[4] = 0x80;				/* received OK */
+	if (frame[0] & 1) {
+		hdr[5] = (frame[0] == 0xff && frame[1] == 0xff) ?
+				 0x02 : 0x01;	/* broadcast, multicast */
+	} else {
+		hdr[5] = 0;
+	}
+	hdr[6] = 0;
+	hdr[7] = 0;
+	crc = ~enc_crc(frame, len);
+
+	enc_ringput(card, &head, hdr, sizeof(hdr));
+	enc_ringput(card, &head, frame, len);
+	for (i = 0; i < 4; i++) {
+		hdr[i] = (crc >> (8 * i)) & 0xff;
+	}
+	enc_ringput(card, &head, hdr, 4);
+
+	REG(card, ERXHEAD) = SWAPBYTES(next);
+	card->pktcnt++;
+	card->nrx++;
+	return 1;
+}
+
+/* Copy into the receive ring at *headp, wrapping at the end */
+static void enc_ringput(card, headp, p, len)
+struct enc_card *card;
+unsigned short *headp;
+unsigned char *p;
+int len;
+{
+	unsigned short head = *headp;
+
+	while (len--) {
+		card->mem[head++] = *p++;
+		if (head >= ENC_MEMSIZE) {
+			head = PTR(card, ERXST);
+		}
+	}
+	*headp = head;
+}
+
+/* Would the receive filters take this frame? */
+static int enc_filter(card, frame, len)
+struct enc_card *card;
+unsigned char *frame;
+int len;
+{
+	unsigned short fcon = REG(card, ERXFCON);
+	int i, bcast, tome;
+
+	if (len < 14) {
+		return 0;
+	}
+	bcast = 1;
+	tome = 1;
+	for (i = 0; i < 6; i++) {
+		bcast &= frame[i] == 0xff;
+		tome &= frame[i] == card->mac[i];
+	}
+	if ((fcon & ERXFCON_UCEN) && tome) {
+		return 1;
+	}
+	if ((fcon & ERXFCON_NOTMEEN) && !(frame[0] & 1) && !tome) {
+		return 1;
+	}
+	if ((fcon & ERXFCON_BCEN) && bcast) {
+		return 1;
+	}
+	if ((fcon & ERXFCON_MCEN) && (frame[0] & 1) && !bcast) {
+		return 1;
+	}
+	if ((fcon & ERXFCON_HTEN) && enc_hashmatch(card, frame)) {
+		return 1;
+	}
+
+	/* The pattern match filter takes frames whose destination is of the
+	 * kind PMEN says, if the pattern matches */
+	switch ((fcon & ERXFCON_PMEN_MASK) >> ERXFCON_PMEN_SHIFT) {
+	case 0x0:
+		return 0;
+	case 0x1:
+		break;
+	case 0x2:
+		if (!(frame[0] & 1) || bcast) {
+			return 0;
+		}
+		break;
+	case 0x3:
+		if ((frame[0] & 1) && !bcast) {
+			return 0;
+		}
+		break;
+	case 0x4:
+		if (!bcast) {
+			return 0;
+		}
+		break;
+	case 0x5:
+		if (bcast) {
+			return 0;
+		}
+		break;
+	case 0x6:
+		if (frame[0] & 1) {
+			return 0;
+		}
+		break;
+	case 0x7:
+		if (!(frame[0] & 1)) {
+			return 0;
+		}
+		break;
+	case 0x8:
+		if (!enc_hashmatch(card, frame)) {
+			return 0;
+		}
+		break;
+	default:
+		host_panic("enc: magic packet filter not modelled");
+	}
+	return enc_pmatch(card, frame, len) ^ !!(fcon & ERXFCON_NOTPM);
+}
+
+/* Does the destination address hit the hash table? Bits 28:23 of the CRC of
+ * the address, taken most significant bit first, index it. */
+static int enc_hashmatch(card, frame)
+struct enc_card *card;
+unsigned char *frame;
+{
+	unsigned short eht;
+	unsigned long crc, rev;
+	int i, h;
+
+	crc = enc_crc(frame, 6);
+	rev = 0;
+	for (i = 0; i < 32; i++) {
+		rev = (rev << 1) | ((crc >> i) & 1);
+	}
+	h = (rev >> 23) & 0x3f;
+	eht = SWAPBYTES(REG(card, EHT1 + 2 * (h >> 4)));
+	return (eht & BIT(h & 0xf)) != 0;
+}
+
+/* Does the frame match the pattern? The chip takes the internet checksum of
+ * the bytes of a 64-byte window, starting EPMO bytes into the frame, that are
+ * selected by the mask, packed together, and compares it with EPMCS. The
+ * window can take in the CRC, but one that runs off the end of that doesn't
+ * match.
+ *
+ * The driver writes the mask straight from memory, without swapping, so the
+ * mask registers are in memory order here (as the address registers are), and
+ * byte n of them selects byte n of the window. EPMCS is the checksum as the 68k
+ * computes it, like EDMACS. */
+static int enc_pmatch(card, frame, len)
+struct enc_card *card;
+unsigned char *frame;
+int len;
+{
+	unsigned char *mask = (unsigned char *)&REG(card, EPMM1);
+	unsigned char win[64];
+	unsigned long sum = 0, fcs;
+	int i, n, odd = 0;
+
+	if (PTR(card, EPMOL) + (int)sizeof(win) > len + 4) {
+		return 0;
+	}
+	fcs = ~enc_crc(frame, len);
+	for (i = 0; i < (int)sizeof(win); i++) {
+		n = PTR(card, EPMOL) + i;
+		win[i] = n < len ? frame[n] : (fcs >> (8 * (n - len))) & 0xff;
+	}
+	for (i = 0; i < (int)sizeof(win); i++) {
+		if (mask[i >> 3] & (1 << (i & 7))) {
+			sum += odd ? win[i] : win[i] << 8;
+			odd = !odd;
+		}
+	}
+	while (sum >> 16) {
+		sum = (sum >> 16) + (sum & 0xffff);
+	}
+	return (~sum & 0xffff) == REG(card, EPMCS);
+}
+
+/* The ethernet CRC32 of len bytes, taken least significant bit first, and
+ * not complemented */
+static unsigned long enc_crc(p, len)
+unsigned char *p;
+int len;
+{
+	unsigned long crc = 0xffffffff;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+		}
+	}
+	return crc;
+}
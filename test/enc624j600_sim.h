@@ -0,0 +1,92 @@
+/* A software model of the ENC624J600, for running the driver on the host
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * This is included ahead of everything else in the driver and the harness (see
+ * the Makefile), and points the driver's register accessors and SE_BASE() at
+ * the model. Each slot can hold a card. Its buffer memory is a plain array,
+ * which the driver reads and writes directly, as it does on the real thing; its
+ * registers live in a separate array that only enc_read() and enc_write() get
+ * at, so that they can act on accesses as the chip does.
+ *
+ * What's modelled: the receive ring, packet counter and receive filters
+ * (unicast, broadcast, multicast, hash table, promiscuous and pattern match,
+ * but not magic packets), the transmitter, the DMA checksum engine, the
+ * interrupt flags and enables, link state, and reset. Everything happens
+ * at once: a transmit is finished by the time TXRTS has been set, unless the
+ * card has been told to stall, and the DMA engine likewise.
+ *
+ * Registers are kept as the 68k sees them across the byte-swapped bus, so the
+ * register constants in enc624j600_registers.h can be used as they are, and
+ * pointers have to be put through SWAPBYTES(). The 16-bit fields of the receive
+ * ring headers are laid out in memory so that the host reads them the same way
+ * the 68k does. Frame data is in wire order.
+ *
+ * With enc_log set, every register access is printed as setrace -r prints the
+ * driver's own log, with values as a 68k would see them, so that a log from the
+ * model can be compared with one from a real card. sereplay plays either kind
+ * back into the model.
+ */
+
+#ifndef ENC624J600_SIM_H
+#define ENC624J600_SIM_H
+
+/* Size of buffer memory. The receive ring always ends here. */
+#define ENC_MEMSIZE 0x6000
+
+/* Registers are at 0x7e00 to 0x7eff */
+#define ENC_REGBASE 0x7e00
+#define ENC_NREGS 0x80
+
+struct enc_card {
+	unsigned char mem[ENC_MEMSIZE];		/* buffer memory, at the base
+						 * address */
+	unsigned short regs[ENC_NREGS];		/* registers, CPU view */
+	int present;				/* a card is in this slot */
+	int slot;				/* NuBus slot */
+	unsigned char mac[6];			/* factory ethernet address */
+	int link;				/* link is up */
+	int fdx;				/* link is full duplex */
+	int pktcnt;				/* packet counter */
+	int txstall;				/* transmitter never finishes */
+
+	/* Called with each frame the card sends, without its CRC */
+	void (*txhook)(struct enc_card *card, unsigned char *frame, int len);
+
+	/* counters */
+	int nreads;				/* register reads */
+	int nwrites;				/* register writes */
+	int nrx;				/* frames put in the ring */
+	int nrxfilt;				/* frames filtered out */
+	int nrxabort;				/* frames dropped, no room */
+	int ntx;				/* frames sent */
+	int ndma;				/* DMA checksums done */
+};
+
+extern struct enc_card enc_cards[16];
+extern int enc_log;			/* print register accesses */
+
+struct enc_card *enc_attach(int slot, unsigned char *mac);
+struct enc_card *enc_lookup(unsigned char *base);
+unsigned char *enc_base(int slot);
+int enc_rx(struct enc_card *card, unsigned char *frame, int len);
+void enc_setlink(struct enc_card *card, int up, int fdx);
+int enc_irq(struct enc_card *card);
+void enc_txfinish(struct enc_card *card);
+unsigned short enc_read(unsigned char *base, int reg);
+void enc_write(unsigned char *base, int reg, int value);
+unsigned short enc_peek(struct enc_card *card, int reg);
+unsigned short enc_busval(int reg, int value);
+char *enc_regname(int reg);
+
+#define ENC624J600_READ_REG(base, reg_offset) \
+	enc_read((unsigned char *)(base), (reg_offset))
+#define ENC624J600_WRITE_REG(base, reg_offset, value) \
+	enc_write((unsigned char *)(base), (reg_offset), (value))
+#define SE_BASE(slot) enc_base(slot)
+
+/* long is int here (see the Makefile), which won't hold a pointer. Only the
+ * low bits matter to the driver. */
+#define SE_ADDR(p) ((unsigned long)((caddr_t)(p) - (caddr_t)0))
+
+#endif
@@ -0,0 +1,84 @@
+/* Host services for the test harness (see host.h)
+ *
+ * Copyright 2024, Richard Halkyard
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "host.h"
+
+int host_verbose;
+
+void host_print(char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	fflush(stdout);
+}
+
+void host_vprint(char *fmt, __builtin_va_list ap)
+{
+	vprintf(fmt, ap);
+	fflush(stdout);
+}
+
+void host_exit(int status)
+{
+	exit(status);
+}
+
+void host_panic(char *msg)
+{
+	fflush(stdout);
+	fprintf(stderr, "panic: %s\n", msg);
+	abort();
+}
+
+/* Seconds since some point in the past */
+double host_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read a whole file into memory. Returns 0 if it can't be read. */
+unsigned char *host_readfile(char *name, int *lenp)
+{
+	FILE *f;
+	unsigned char *buf;
+	long len;
+
+	if ((f = fopen(name, "rb")) == NULL) {
+		perror(name);
+		return 0;
+	}
+	if (fseek(f, 0L, SEEK_END) < 0 || (len = ftell(f)) < 0 ||
+	    fseek(f, 0L, SEEK_SET) < 0) {
+		perror(name);
+		fclose(f);
+		return 0;
+	}
+	if ((buf = malloc(len ? len : 1)) == NULL ||
+	    fread(buf, 1, len, f) != (size_t)len) {
+		perror(name);
+		free(buf);
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+	*lenp = (int)len;
+	return buf;
+}
+
+int host_atoi(char *s)
+{
+	return (int)strtol(s, (char **)0, 0);
+}
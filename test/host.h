@@ -0,0 +1,24 @@
+/* Host services for the test harness
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * The driver and the harness's kernel are built with long as 32 bits, as on
+ * the 68k, and without the host's headers (see the Makefile), so they can't
+ * call the C library directly. host.c is built normally and does it for them,
+ * through an interface that only uses types both sides agree on.
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+extern int host_verbose;		/* show the driver's messages */
+
+void host_print(char *fmt, ...);
+void host_vprint(char *fmt, __builtin_va_list ap);
+void host_exit(int status);
+void host_panic(char *msg);
+double host_time(void);
+unsigned char *host_readfile(char *name, int *lenp);
+int host_atoi(char *s);
+
+#endif
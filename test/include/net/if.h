@@ -0,0 +1,86 @@
+/* Host test harness: stand-in for the A/UX kernel's <net/if.h> */
+#ifndef _NET_IF_H
+#define _NET_IF_H
+
+#include <sys/socket.h>
+
+struct ifqueue {
+	struct mbuf *ifq_head;
+	struct mbuf *ifq_tail;
+	int ifq_len;
+	int ifq_maxlen;
+	int ifq_drops;
+};
+
+struct ifaddr {
+	struct sockaddr ifa_addr;	/* address of interface */
+	struct ifnet *ifa_ifp;		/* back-pointer to interface */
+	struct ifaddr *ifa_next;	/* next address for interface */
+};
+
+struct ifnet {
+	char *if_name;			/* name, e.g. ``se'' */
+	short if_unit;			/* sub-unit for lower level driver */
+	short if_mtu;			/* maximum transmission unit */
+	short if_flags;			/* up/down, broadcast, etc. */
+	struct ifaddr *if_addrlist;	/* linked list of addresses */
+	struct ifqueue if_snd;		/* output queue */
+	int (*if_init)();
+	int (*if_output)();
+	int (*if_ioctl)();
+	int if_ipackets;
+	int if_ierrors;
+	int if_opackets;
+	int if_oerrors;
+	int if_collisions;
+	struct ifnet *if_next;
+};
+
+#define IFF_UP 0x1
+#define IFF_BROADCAST 0x2
+#define IFF_NOTRAILERS 0x20
+#define IFF_RUNNING 0x40
+
+struct ifreq {
+	char ifr_name[16];
+	union {
+		struct sockaddr ifru_addr;
+		short ifru_flags;
+		caddr_t ifru_data;
+	} ifr_ifru;
+};
+
+#define ifr_addr ifr_ifru.ifru_addr
+#define ifr_flags ifr_ifru.ifru_flags
+#define ifr_data ifr_ifru.ifru_data
+
+#define IFQ_MAXLEN 50
+
+#define IF_QFULL(ifq) ((ifq)->ifq_len >= (ifq)->ifq_maxlen)
+#define IF_DROP(ifq) ((ifq)->ifq_drops++)
+#define IF_ENQUEUE(ifq, m) { \
+	(m)->m_act = 0; \
+	if ((ifq)->ifq_tail == 0) \
+		(ifq)->ifq_head = m; \
+	else \
+		(ifq)->ifq_tail->m_act = m; \
+	(ifq)->ifq_tail = m; \
+	(ifq)->ifq_len++; \
+}
+#define IF_DEQUEUE(ifq, m) { \
+	(m) = (ifq)->ifq_head; \
+	if (m) { \
+		if (((ifq)->ifq_head = (m)->m_act) == 0) \
+			(ifq)->ifq_tail = 0; \
+		(m)->m_act = 0; \
+		(ifq)->ifq_len--; \
+	} \
+}
+
+extern struct ifnet *ifnet;
+
+void if_attach();
+struct ifaddr *ifa_ifwithaddr();
+int looutput();
+
+#endif
@@ -0,0 +1,14 @@
+/* Host test harness: stand-in for the A/UX kernel's <net/netisr.h> */
+#ifndef _NET_NETISR_H
+#define _NET_NETISR_H
+
+#define NETISR_IP 2
+
+/* Points at AppleTalk's software interrupt number once it is running, and is
+ * null until then */
+extern int *NETISR_ET;
+
+extern int netisr;
+#define schednetisr(anisr) (netisr |= 1 << (anisr))
+
+#endif
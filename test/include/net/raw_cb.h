@@ -0,0 +1,23 @@
+/* Host test harness: stand-in for the A/UX kernel's <net/raw_cb.h> */
+#ifndef _NET_RAW_CB_H
+#define _NET_RAW_CB_H
+
+struct rawcb {
+	struct rawcb *rcb_next;		/* doubly linked list */
+	struct rawcb *rcb_prev;
+	struct socket *rcb_socket;	/* back pointer to socket */
+	struct sockaddr rcb_faddr;	/* destination address */
+	struct sockaddr rcb_laddr;	/* socket's address */
+	struct sockproto rcb_proto;	/* protocol family, protocol */
+	int rcb_flags;
+};
+
+#define RAW_LADDR 0x01
+
+#define sotorawcb(so) ((struct rawcb *)(so)->so_pcb)
+
+extern struct rawcb rawcb;
+
+void raw_input();
+
+#endif
@@ -0,0 +1,39 @@
+/* Host test harness: stand-in for the A/UX kernel's <netinet/if_ether.h> */
+#ifndef _NETINET_IF_ETHER_H
+#define _NETINET_IF_ETHER_H
+
+#include <net/if.h>
+#include <netinet/in.h>
+
+#ifdef NET_SWAPPED
+#pragma scalar_storage_order big-endian
+#endif
+struct ether_header {
+	u_char ether_dhost[6];
+	u_char ether_shost[6];
+	u_short ether_type;
+};
+#ifdef NET_SWAPPED
+#pragma scalar_storage_order default
+#endif
+
+#define ETHERTYPE_IP 0x0800
+#define ETHERTYPE_ARP 0x0806
+#define ETHERTYPE_REVARP 0x8035
+
+#define ETHERMTU 1500
+#define ETHERMIN (60 - 14)
+
+struct arpcom {
+	struct ifnet ac_if;		/* network-visible interface */
+	u_char ac_enaddr[6];		/* ethernet hardware address */
+	struct in_addr ac_ipaddr;	/* copy of ip address */
+};
+
+void arpinput();
+void revarpinput();
+void arpwhohas();
+int arpresolve();
+void localetheraddr();
+
+#endif
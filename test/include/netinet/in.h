@@ -0,0 +1,49 @@
+/* Host test harness: stand-in for the A/UX kernel's <netinet/in.h>.
+ *
+ * The driver looks at some header fields as numbers, the way a 68k sees them.
+ * On a little-endian host, GCC's scalar_storage_order pragma makes the structs
+ * that are laid over network data (here, <netinet/if_ether.h> and
+ * <netinet/ip.h>) big-endian, so the driver sees the same numbers. */
+#ifndef _NETINET_IN_H
+#define _NETINET_IN_H
+
+#include <sys/types.h>
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NET_SWAPPED
+#endif
+
+#ifdef NET_SWAPPED
+#pragma scalar_storage_order big-endian
+#endif
+struct in_addr {
+	u_long s_addr;
+};
+#ifdef NET_SWAPPED
+#pragma scalar_storage_order default
+#endif
+
+struct sockaddr_in {
+	short sin_family;
+	u_short sin_port;
+	struct in_addr sin_addr;
+	char sin_zero[8];
+};
+
+#define INADDR_ANY 0x00000000
+#define INADDR_BROADCAST 0xffffffff
+
+#define IPPROTO_TCP 6
+#define IPPROTO_UDP 17
+
+#ifdef NET_SWAPPED
+#define htons(x) ((u_short)((((x) & 0xff) << 8) | (((x) >> 8) & 0xff)))
+#else
+#define htons(x) (x)
+#endif
+#define ntohs(x) htons(x)
+
+u_long in_lnaof();
+int in_broadcast();
+
+#endif
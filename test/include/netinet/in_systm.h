@@ -0,0 +1,5 @@
+/* Host test harness: stand-in for the A/UX kernel's <netinet/in_systm.h>,
+ * which the driver doesn't need anything from */
+#ifndef _NETINET_IN_SYSTM_H
+#define _NETINET_IN_SYSTM_H
+#endif
@@ -0,0 +1,7 @@
+/* Host test harness: stand-in for the A/UX kernel's <netinet/in_var.h> */
+#ifndef _NETINET_IN_VAR_H
+#define _NETINET_IN_VAR_H
+
+#define IA_SIN(ia) ((struct sockaddr_in *)(&(ia)->ifa_addr))
+
+#endif
@@ -0,0 +1,29 @@
+/* Host test harness: stand-in for the A/UX kernel's <netinet/ip.h>. The
+ * header is big-endian, bit-fields and all, as on the 68k (see
+ * <netinet/in.h>). */
+#ifndef _NETINET_IP_H
+#define _NETINET_IP_H
+
+#ifdef NET_SWAPPED
+#pragma scalar_storage_order big-endian
+#endif
+struct ip {
+	u_char ip_v:4,			/* version */
+	       ip_hl:4;			/* header length */
+	u_char ip_tos;			/* type of service */
+	short ip_len;			/* total length */
+	u_short ip_id;			/* identification */
+	short ip_off;			/* fragment offset field */
+	u_char ip_ttl;			/* time to live */
+	u_char ip_p;			/* protocol */
+	u_short ip_sum;			/* checksum */
+	struct in_addr ip_src, ip_dst;	/* source and dest address */
+};
+#ifdef NET_SWAPPED
+#pragma scalar_storage_order default
+#endif
+
+#define IP_MF 0x2000			/* more fragments flag */
+#define IP_OFFMASK 0x1fff		/* mask for fragmenting bits */
+
+#endif
@@ -0,0 +1,8 @@
+/* Host test harness: stand-in for the A/UX kernel's <netinet/ip_var.h> */
+#ifndef _NETINET_IP_VAR_H
+#define _NETINET_IP_VAR_H
+
+extern struct ifqueue ipintrq;		/* IP input queue */
+extern struct ifqueue etintrq;		/* AppleTalk input queue */
+
+#endif
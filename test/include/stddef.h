@@ -0,0 +1,7 @@
+/* Host test harness: stand-in for <stddef.h> */
+#ifndef _STDDEF_H
+#define _STDDEF_H
+
+#define offsetof(t, m) ((int)__builtin_offsetof(t, m))
+
+#endif
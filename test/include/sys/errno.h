@@ -0,0 +1,23 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/errno.h> */
+#ifndef _SYS_ERRNO_H
+#define _SYS_ERRNO_H
+
+#define EPERM 1
+#define ENOENT 2
+#define ENXIO 6
+#define E2BIG 7
+#define EFAULT 14
+#define EBUSY 16
+#define EEXIST 17
+#define EINVAL 22
+#define ENOSPC 28
+#define EPROTOTYPE 41
+#define ENOPROTOOPT 42
+#define EOPNOTSUPP 45
+#define EAFNOSUPPORT 47
+#define EADDRNOTAVAIL 49
+#define ENETDOWN 50
+#define ENOBUFS 55
+#define ENOTCONN 57
+
+#endif
@@ -0,0 +1,30 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/ioctl.h> */
+#ifndef _SYS_IOCTL_H
+#define _SYS_IOCTL_H
+
+#define IOCPARM_MASK 0x7f
+#define IOC_VOID 0x20000000
+#define IOC_OUT 0x40000000
+#define IOC_IN 0x80000000
+#define IOC_INOUT (IOC_IN | IOC_OUT)
+/* The kernel takes the command as an int, which on the 68k is as wide as
+ * these constants; on the host they're unsigned long, and would never compare
+ * equal to an int with the top bit set. So make them ints here. */
+#define _IO(x, y) ((int)(IOC_VOID | ((x) << 8) | (y)))
+#define _IOR(x, y, t) ((int)(IOC_OUT | ((sizeof(t) & IOCPARM_MASK) << 16) | \
+			    ((x) << 8) | (y)))
+#define _IOW(x, y, t) ((int)(IOC_IN | ((sizeof(t) & IOCPARM_MASK) << 16) | \
+			    ((x) << 8) | (y)))
+#define _IOWR(x, y, t) \
+	((int)(IOC_INOUT | ((sizeof(t) & IOCPARM_MASK) << 16) | ((x) << 8) | \
+	       (y)))
+
+#define SIOCSIFADDR _IOW('i', 12, struct ifreq)
+#define SIOCSIFFLAGS _IOW('i', 16, struct ifreq)
+
+/* AppleTalk's multicast address ioctls */
+#define SIOCSMAR _IOW('i', 40, struct sockaddr)
+#define SIOCUMAR _IOW('i', 41, struct sockaddr)
+#define SIOCGMAR _IOWR('i', 42, struct sockaddr)
+
+#endif
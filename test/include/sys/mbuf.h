@@ -0,0 +1,50 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/mbuf.h>. The mbufs
+ * and clusters come from fixed pools in kern.c. */
+#ifndef _SYS_MBUF_H
+#define _SYS_MBUF_H
+
+#include <sys/types.h>
+
+#define MLEN 112
+#define MCLBYTES 1024
+#define M_COPYALL 1000000000
+
+/* On the 68k there are SE_RXALIGN - 4 bytes in front of a received frame for
+ * the driver to prepend the interface pointer to an 802.3 frame. A host
+ * pointer is 8 bytes, so give it room for the rest. */
+#define MHEADROOM 8
+
+struct mbuf {
+	struct mbuf *m_next;		/* next buffer in chain */
+	u_long m_off;			/* offset of data from mbuf */
+	short m_len;			/* amount of data in this mbuf */
+	short m_type;			/* type of data */
+	u_char m_pad[MHEADROOM];
+	u_char m_dat[MLEN];		/* data storage */
+	struct mbuf *m_act;		/* link in higher-level mbuf list */
+};
+
+#define MMINOFF ((int)__builtin_offsetof(struct mbuf, m_dat))
+#define MMAXOFF (MMINOFF + MLEN)
+
+#define MT_FREE 0
+#define MT_DATA 1
+#define MT_HEADER 2
+
+#define M_DONTWAIT 0
+#define M_WAIT 1
+
+#define mtod(m, t) ((t)((caddr_t)(m) + (m)->m_off))
+
+#define MGET(m, i, t) ((m) = m_get((i), (t)))
+#define MCLGET(m) mclget(m)
+
+struct mbuf *m_get();
+struct mbuf *m_free();
+struct mbuf *m_copy();
+struct mbuf *m_pullup();
+void m_freem();
+void m_adj();
+void mclget();
+
+#endif
@@ -0,0 +1,38 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/param.h>, along with
+ * declarations of the kernel routines the driver calls */
+#ifndef _SYS_PARAM_H
+#define _SYS_PARAM_H
+
+#include <sys/types.h>
+
+#define HZ 60
+#define NULL 0
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+/* Kernel routines with the same names as C library ones go by other names
+ * here, so that the two don't get mixed up (kern.c) */
+#define printf kprintf
+#define bcopy kbcopy
+#define bzero kbzero
+#define bcmp kbcmp
+
+int kprintf(char *fmt, ...);
+void kbcopy();
+void kbzero();
+int kbcmp();
+void panic();
+int splimp();
+int splnet();
+void splx();
+void timeout();
+void untimeout();
+int suser();
+int copyin();
+int copyout();
+int iocheck();
+
+extern int lbolt;
+
+#endif
@@ -0,0 +1,9 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/proc.h> */
+#ifndef _SYS_PROC_H
+#define _SYS_PROC_H
+
+struct proc {
+	int p_pid;
+};
+
+#endif
@@ -0,0 +1,16 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/protosw.h> */
+#ifndef _SYS_PROTOSW_H
+#define _SYS_PROTOSW_H
+
+struct protosw {
+	short pr_type;
+	int (*pr_output)();
+	int (*pr_usrreq)();
+};
+
+/* pr_usrreq requests, as in 4.3BSD */
+#define PRU_ATTACH 0
+#define PRU_DETACH 1
+#define PRU_ABORT 10
+
+#endif
@@ -0,0 +1,31 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/socket.h> */
+#ifndef _SYS_SOCKET_H
+#define _SYS_SOCKET_H
+
+#include <sys/types.h>
+
+struct sockaddr {
+	u_short sa_family;
+	char sa_data[14];
+};
+
+struct sockproto {
+	u_short sp_family;
+	u_short sp_protocol;
+};
+
+struct socket {
+	caddr_t so_pcb;
+};
+
+#define SOCK_RAW 3
+
+#define AF_UNSPEC 0
+#define AF_INET 2
+#define AF_APPLETALK 16
+#define AF_ETHERLINK 20
+
+#define PF_INET AF_INET
+#define PF_ETHERLINK AF_ETHERLINK
+
+#endif
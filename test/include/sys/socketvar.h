@@ -0,0 +1,5 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/socketvar.h>, which
+ * the driver doesn't need anything from */
+#ifndef _SYS_SOCKETVAR_H
+#define _SYS_SOCKETVAR_H
+#endif
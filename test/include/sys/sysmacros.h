@@ -0,0 +1,5 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/sysmacros.h>, which
+ * the driver doesn't need anything from */
+#ifndef _SYS_SYSMACROS_H
+#define _SYS_SYSMACROS_H
+#endif
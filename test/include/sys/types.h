@@ -0,0 +1,12 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/types.h> */
+#ifndef _SYS_TYPES_H
+#define _SYS_TYPES_H
+
+typedef char *caddr_t;
+typedef unsigned char u_char;
+typedef unsigned short u_short;
+typedef unsigned int u_int;
+typedef unsigned long u_long;
+typedef long off_t;
+
+#endif
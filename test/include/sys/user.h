@@ -0,0 +1,13 @@
+/* Host test harness: stand-in for the A/UX kernel's <sys/user.h> */
+#ifndef _SYS_USER_H
+#define _SYS_USER_H
+
+#include <sys/proc.h>
+
+struct user {
+	struct proc *u_procp;
+};
+
+extern struct user u;
+
+#endif
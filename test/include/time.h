@@ -0,0 +1,10 @@
+/* Host test harness: stand-in for the A/UX kernel's <time.h> */
+#ifndef _TIME_H
+#define _TIME_H
+
+struct timeval {
+	long tv_sec;
+	long tv_usec;
+};
+
+#endif
@@ -0,0 +1,21 @@
+/* Host test harness: stand-in for the A/UX kernel's <vaxuba/ubavar.h> */
+#ifndef _VAXUBA_UBAVAR_H
+#define _VAXUBA_UBAVAR_H
+
+struct uba_device {
+	int ui_unit;
+};
+
+struct uba_driver {
+	int (*ud_probe)();
+	int (*ud_attach)();
+	unsigned short *ud_addr;
+	struct uba_device **ud_dinfo;
+};
+
+/* What an interrupt routine is called with */
+struct args {
+	int a_dev;
+};
+
+#endif
@@ -0,0 +1,839 @@
+/* Just enough of the A/UX kernel to run the driver on the host
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * This provides the routines and data the driver uses from the kernel: mbufs,
+ * the spl levels, timeouts, the interface list and the hooks into the
+ * protocols. Nothing runs by itself. Clock ticks happen when the harness calls
+ * kern_tick(), and interrupts when it calls kern_intr(), which services every
+ * card whose interrupt line is asserted. What the driver passes up is left on
+ * queues for the harness to look at.
+ */
+
+#include <sys/errno.h>
+#include <sys/ioctl.h>
+#include <sys/mbuf.h>
+#include <sys/param.h>
+#include <sys/proc.h>
+#include <sys/protosw.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <vaxuba/ubavar.h>
+
+#include <net/if.h>
+#include <net/netisr.h>
+#include <net/raw_cb.h>
+#include <netinet/if_ether.h>
+#include <netinet/in.h>
+#include <netinet/ip_var.h>
+
+#include "host.h"
+#include "kern.h"
+
+/* The driver */
+extern struct uba_driver sedriver;
+extern void seint();
+
+/* Kernel data the driver uses */
+int lbolt;
+int secnt;
+int seaddr[16];
+struct ifnet loif;
+int raw_usrreq();
+struct protosw ensw[1] = { { SOCK_RAW, 0, raw_usrreq } };
+struct ifnet *ifnet;
+struct ifqueue ipintrq = { 0, 0, 0, IFQ_MAXLEN };
+struct ifqueue etintrq = { 0, 0, 0, IFQ_MAXLEN };
+int netisr;
+int *NETISR_ET;
+struct rawcb rawcb = { &rawcb, &rawcb };
+struct proc kern_proc;
+struct user u = { &kern_proc };
+
+/* Harness data (see kern.h) */
+int kern_mbufs;
+int kern_clusters;
+int kern_mgets;
+int kern_mclgets;
+int kern_mlimit = KERN_NMBUFS;
+struct ifqueue kern_arpq = { 0, 0, 0, 1000 };
+struct ifqueue kern_revarpq = { 0, 0, 0, 1000 };
+struct ifqueue kern_rawq = { 0, 0, 0, 1000 };
+int kern_rawproto;
+int kern_looutputs;
+int kern_netisr_et = 3;
+unsigned char kern_arpmac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+/*
+mbufs. Clusters come after the mbufs in the arena, so that m_off (which is
+unsigned) can reach them; an mbuf whose data is beyond its own end has a
+cluster. Each cluster has MHEADROOM bytes in front of it, like the mbufs (see
+<sys/mbuf.h>).
+*/
+struct kern_cluster {
+	u_char kc_pad[MHEADROOM];
+	u_char kc_dat[MCLBYTES];
+};
+
+struct {
+	struct mbuf ka_mbufs[KERN_NMBUFS];
+	struct kern_cluster ka_clusters[KERN_NCLUSTERS];
+} kern_arena;
+
+static struct mbuf *kern_mfree;
+static short kern_clref[KERN_NCLUSTERS];
+static int kern_clnext;
+
+/* Which cluster each mbuf has. This can't be worked out from the data pointer,
+ * since trimming the data can leave that at the start of the next cluster. */
+static short kern_mcl[KERN_NMBUFS];
+
+#define M_HASCL(m) ((m)->m_off >= sizeof(struct mbuf))
+#define M_CLUSTER(m) kern_mcl[(m) - kern_arena.ka_mbufs]
+
+static void kern_minit()
+{
+	register int i;
+
+	kern_mfree = 0;
+	for (i = KERN_NMBUFS - 1; i >= 0; i--) {
+		kern_arena.ka_mbufs[i].m_type = MT_FREE;
+		kern_arena.ka_mbufs[i].m_next = kern_mfree;
+		kern_mfree = &kern_arena.ka_mbufs[i];
+	}
+}
+
+struct mbuf *m_get(canwait, type)
+int canwait;
+int type;
+{
+	register struct mbuf *m;
+
+	if (kern_mfree == 0 && kern_mbufs == 0) {
+		kern_minit();
+	}
+	if (kern_mbufs >= kern_mlimit || (m = kern_mfree) == 0) {
+		return 0;
+	}
+	kern_mfree = m->m_next;
+	kern_mbufs++;
+	kern_mgets++;
+	m->m_next = 0;
+	m->m_act = 0;
+	m->m_off = MMINOFF;
+	m->m_len = 0;
+	m->m_type = type;
+	return m;
+}
+
+/* Attach a cluster to m, setting m_len to its size. m is left alone if there
+ * aren't any. */
+void mclget(m)
+struct mbuf *m;
+{
+	register int i;
+
+	for (i = 0; i < KERN_NCLUSTERS; i++) {
+		if (kern_clref[kern_clnext] == 0) {
+			break;
+		}
+		kern_clnext = (kern_clnext + 1) % KERN_NCLUSTERS;
+	}
+	if (i == KERN_NCLUSTERS) {
+		return;
+	}
+	kern_clref[kern_clnext] = 1;
+	M_CLUSTER(m) = kern_clnext;
+	m->m_off = (caddr_t)kern_arena.ka_clusters[kern_clnext].kc_dat -
+		   (caddr_t)m;
+	m->m_len = MCLBYTES;
+	kern_clusters++;
+	kern_mclgets++;
+}
+
+struct mbuf *m_free(m)
+struct mbuf *m;
+{
+	struct mbuf *n;
+	int cl;
+
+	if (m->m_type == MT_FREE) {
+		panic("m_free: already free");
+	}
+	if (M_HASCL(m)) {
+		cl = M_CLUSTER(m);
+		if (cl < 0 || cl >= KERN_NCLUSTERS || kern_clref[cl] <= 0) {
+			panic("m_free: bad cluster");
+		}
+		if (--kern_clref[cl] == 0) {
+			kern_clusters--;
+		}
+	}
+	n = m->m_next;
+	m->m_type = MT_FREE;
+	m->m_next = kern_mfree;
+	kern_mfree = m;
+	kern_mbufs--;
+	return n;
+}
+
+void m_freem(m)
+register struct mbuf *m;
+{
+	while (m) {
+		m = m_free(m);
+	}
+}
+
+/* Copy len bytes of a chain from off on. Clusters are shared rather than
+ * copied. */
+struct mbuf *m_copy(m, off, len)
+register struct mbuf *m;
+int off;
+register int len;
+{
+	register struct mbuf *n, **np;
+	struct mbuf *top = 0;
+
+	while (m && off >= m->m_len) {
+		off -= m->m_len;
+		m = m->m_next;
+	}
+	np = &top;
+	while (m && len > 0) {
+		if ((n = m_get(M_DONTWAIT, m->m_type)) == 0) {
+			m_freem(top);
+			return 0;
+		}
+		n->m_len = MIN(len, m->m_len - off);
+		if (M_HASCL(m)) {
+			n->m_off = ((caddr_t)m + m->m_off + off) - (caddr_t)n;
+			M_CLUSTER(n) = M_CLUSTER(m);
+			kern_clref[M_CLUSTER(m)]++;
+		} else {
+			bcopy(mtod(m, caddr_t) + off, mtod(n, caddr_t),
+			      n->m_len);
+		}
+		len -= n->m_len;
+		off = 0;
+		*np = n;
+		np = &n->m_next;
+		m = m->m_next;
+	}
+	return top;
+}
+
+/* Make the first len bytes of a chain contiguous in its first mbuf. Frees the
+ * chain and returns 0 if it can't. */
+struct mbuf *m_pullup(m, len)
+register struct mbuf *m;
+int len;
+{
+	register struct mbuf *n;
+	int count;
+
+	if (m->m_len >= len) {
+		return m;
+	}
+	if (len > MLEN || (n = m_get(M_DONTWAIT, m->m_type)) == 0) {
+		m_freem(m);
+		return 0;
+	}
+	while (m && len > 0) {
+		count = MIN(len, m->m_len);
+		bcopy(mtod(m, caddr_t), mtod(n, caddr_t) + n->m_len, count);
+		len -= count;
+		n->m_len += count;
+		m->m_off += count;
+		m->m_len -= count;
+		if (m->m_len == 0) {
+			m = m_free(m);
+		}
+	}
+	n->m_next = m;
+	if (len > 0) {
+		m_freem(n);
+		return 0;
+	}
+	return n;
+}
+
+/* Trim len bytes from the front of a chain, or from the back if len is
+ * negative */
+void m_adj(m, len)
+struct mbuf *m;
+register int len;
+{
+	register struct mbuf *n;
+	int total;
+
+	if (len >= 0) {
+		for (n = m; n && len > 0; n = n->m_next) {
+			if (n->m_len <= len) {
+				len -= n->m_len;
+				n->m_len = 0;
+			} else {
+				n->m_off += len;
+				n->m_len -= len;
+				len = 0;
+			}
+		}
+	} else {
+		total = kern_mlen(m) + len;
+		for (n = m; n; n = n->m_next) {
+			if (n->m_len > total) {
+				n->m_len = total > 0 ? total : 0;
+			}
+			total -= n->m_len;
+		}
+	}
+}
+
+/* Length of the data in a chain */
+int kern_mlen(m)
+register struct mbuf *m;
+{
+	register int len = 0;
+
+	for (; m; m = m->m_next) {
+		len += m->m_len;
+	}
+	return len;
+}
+
+/* Copy the data in a chain out to p */
+void kern_mcopy(m, p)
+register struct mbuf *m;
+unsigned char *p;
+{
+	for (; m; m = m->m_next) {
+		bcopy(mtod(m, caddr_t), (caddr_t)p, m->m_len);
+		p += m->m_len;
+	}
+}
+
+/* Free everything on a queue */
+void kern_drain(q)
+struct ifqueue *q;
+{
+	struct mbuf *m;
+
+	for (;;) {
+		IF_DEQUEUE(q, m);
+		if (m == 0) {
+			break;
+		}
+		m_freem(m);
+	}
+}
+
+/*
+Memory and string routines, which are called something else here so as not to
+collide with the C library's (see <sys/param.h>)
+*/
+void kbcopy(from, to, len)
+register caddr_t from;
+register caddr_t to;
+register int len;
+{
+	if (from < to && from + len > to) {
+		from += len;
+		to += len;
+		while (len-- > 0) {
+			*--to = *--from;
+		}
+	} else {
+		while (len-- > 0) {
+			*to++ = *from++;
+		}
+	}
+}
+
+void kbzero(p, len)
+register caddr_t p;
+register int len;
+{
+	while (len-- > 0) {
+		*p++ = 0;
+	}
+}
+
+int kbcmp(p, q, len)
+register caddr_t p;
+register caddr_t q;
+register int len;
+{
+	while (len-- > 0) {
+		if (*p++ != *q++) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* The driver's console messages, which are only shown with -v */
+int kprintf(char *fmt, ...)
+{
+	__builtin_va_list ap;
+
+	if (host_verbose) {
+		__builtin_va_start(ap, fmt);
+		host_vprint(fmt, ap);
+		__builtin_va_end(ap);
+	}
+	return 0;
+}
+
+void panic(msg)
+char *msg;
+{
+	host_panic(msg);
+}
+
+/*
+Priority levels. Nothing interrupts anything else here, so these only keep
+track of the level, so that kern_intr() can check that it isn't called from
+inside a critical section.
+*/
+static int kern_spl;
+
+int splimp()
+{
+	int s = kern_spl;
+
+	kern_spl = 6;
+	return s;
+}
+
+int splnet()
+{
+	int s = kern_spl;
+
+	kern_spl = MAX(kern_spl, 1);
+	return s;
+}
+
+void splx(s)
+int s;
+{
+	kern_spl = s;
+}
+
+/* Timeouts */
+#define KERN_NCALLOUT 32
+
+static struct kern_callout {
+	int (*kc_func)();
+	caddr_t kc_arg;
+	int kc_time;			/* lbolt when due; 0 = free */
+} kern_callout[KERN_NCALLOUT];
+
+void timeout(func, arg, ticks)
+int (*func)();
+caddr_t arg;
+int ticks;
+{
+	register int i;
+
+	for (i = 0; i < KERN_NCALLOUT; i++) {
+		if (kern_callout[i].kc_time == 0) {
+			kern_callout[i].kc_func = func;
+			kern_callout[i].kc_arg = arg;
+			kern_callout[i].kc_time = lbolt + MAX(ticks, 1);
+			return;
+		}
+	}
+	panic("timeout table overflow");
+}
+
+void untimeout(func, arg)
+int (*func)();
+caddr_t arg;
+{
+	register int i;
+
+	for (i = 0; i < KERN_NCALLOUT; i++) {
+		if (kern_callout[i].kc_time && kern_callout[i].kc_func == func &&
+		    kern_callout[i].kc_arg == arg) {
+			kern_callout[i].kc_time = 0;
+			return;
+		}
+	}
+}
+
+/* Let n clock ticks go by, running the timeouts that come due and servicing
+ * interrupts after each one */
+void kern_tick(n)
+int n;
+{
+	register int i;
+	int (*func)();
+	caddr_t arg;
+
+	while (n-- > 0) {
+		lbolt++;
+		for (i = 0; i < KERN_NCALLOUT; i++) {
+			if (kern_callout[i].kc_time &&
+			    kern_callout[i].kc_time <= lbolt) {
+				func = kern_callout[i].kc_func;
+				arg = kern_callout[i].kc_arg;
+				kern_callout[i].kc_time = 0;
+				(*func)(arg);
+			}
+		}
+		kern_intr();
+	}
+}
+
+/* Call the interrupt handler while any card wants attention. Returns the
+ * number of interrupts taken. */
+int kern_intr()
+{
+	struct args args;
+	register int i, n, taken = 0;
+
+	if (kern_spl) {
+		panic("kern_intr: interrupt at raised priority");
+	}
+	do {
+		n = 0;
+		for (i = 0; i < secnt; i++) {
+			if (enc_lookup(enc_base(seaddr[i])) &&
+			    enc_irq(enc_lookup(enc_base(seaddr[i])))) {
+				args.a_dev = seaddr[i];
+				seint(&args);
+				n++;
+			}
+		}
+		taken += n;
+		if (taken > 10000) {
+			panic("kern_intr: interrupt stuck on");
+		}
+	} while (n);
+	return taken;
+}
+
+/* Interfaces */
+void if_attach(ifp)
+struct ifnet *ifp;
+{
+	register struct ifnet **p = &ifnet;
+
+	while (*p) {
+		p = &(*p)->if_next;
+	}
+	*p = ifp;
+	ifp->if_next = 0;
+	/* as the real one does, for drivers that don't set it themselves */
+	if (ifp->if_snd.ifq_maxlen == 0) {
+		ifp->if_snd.ifq_maxlen = IFQ_MAXLEN;
+	}
+}
+
+struct ifaddr *ifa_ifwithaddr(addr)
+struct sockaddr *addr;
+{
+	return 0;
+}
+
+/* Autoconfiguration: probe and attach a card in each of the slots given, and
+ * return the interface of the given unit, or 0 if it wasn't found */
+struct ifnet *kern_config(nslots, slots, unit)
+int nslots;
+int *slots;
+int unit;
+{
+	static struct uba_device devs[16];
+	register struct ifnet *ifp;
+	int i;
+
+	secnt = nslots;
+	for (i = 0; i < nslots; i++) {
+		seaddr[i] = slots[i];
+		devs[i].ui_unit = i;
+		if ((*sedriver.ud_probe)(&devs[i])) {
+			sedriver.ud_dinfo[i] = &devs[i];
+			(*sedriver.ud_attach)(&devs[i]);
+		}
+	}
+	for (ifp = ifnet; ifp; ifp = ifp->if_next) {
+		if (ifp->if_unit == unit) {
+			return ifp;
+		}
+	}
+	return 0;
+}
+
+/* Give an interface an IP address, which brings it up */
+int kern_ifaddr(ifp, addr)
+struct ifnet *ifp;
+unsigned long addr;
+{
+	struct ifaddr *ifa;
+	static struct ifaddr addrs[16];
+	static int naddrs;
+	struct sockaddr_in *sin;
+
+	if (naddrs == 16) {
+		panic("kern_ifaddr: too many addresses");
+	}
+	ifa = &addrs[naddrs++];
+	sin = (struct sockaddr_in *)&ifa->ifa_addr;
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = addr;
+	ifa->ifa_ifp = ifp;
+	ifa->ifa_next = ifp->if_addrlist;
+	ifp->if_addrlist = ifa;
+	return kern_ioctl(ifp, SIOCSIFADDR, (caddr_t)ifa);
+}
+
+/* Issue an ioctl to an interface, as if from a process */
+int kern_ioctl(ifp, cmd, arg)
+struct ifnet *ifp;
+int cmd;
+caddr_t arg;
+{
+	return (*ifp->if_ioctl)(ifp, cmd, arg);
+}
+
+/* Copy len bytes into a new mbuf chain, in clusters if they don't fit in an
+ * mbuf. Returns 0 if there aren't enough mbufs. */
+struct mbuf *kern_mchain(frame, len)
+unsigned char *frame;
+int len;
+{
+	struct mbuf *m, *top = 0, **mp = &top;
+	int n;
+
+	while (len > 0) {
+		if ((m = m_get(M_DONTWAIT, MT_DATA)) == 0) {
+			m_freem(top);
+			return 0;
+		}
+		n = MLEN;
+		if (len > MLEN) {
+			mclget(m);
+			if (M_HASCL(m)) {
+				n = MCLBYTES;
+			}
+		}
+		m->m_len = MIN(n, len);
+		bcopy((caddr_t)frame, mtod(m, caddr_t), m->m_len);
+		frame += m->m_len;
+		len -= m->m_len;
+		*mp = m;
+		mp = &m->m_next;
+	}
+	return top;
+}
+
+/* Send a chain holding a whole ethernet frame out of an interface, as a raw
+ * ETHERLINK socket would */
+int kern_send(ifp, m)
+struct ifnet *ifp;
+struct mbuf *m;
+{
+	struct sockaddr dst;
+
+	bzero((caddr_t)&dst, sizeof(dst));
+	dst.sa_family = AF_ETHERLINK;
+	return (*ifp->if_output)(ifp, m, &dst);
+}
+
+/* Send a whole ethernet frame from a buffer */
+int kern_output(ifp, frame, len)
+struct ifnet *ifp;
+unsigned char *frame;
+int len;
+{
+	struct mbuf *m;
+
+	if ((m = kern_mchain(frame, len)) == 0) {
+		return ENOBUFS;
+	}
+	return kern_send(ifp, m);
+}
+
+/* Protocols */
+void arpinput(ac, m)
+struct arpcom *ac;
+struct mbuf *m;
+{
+	IF_ENQUEUE(&kern_arpq, m);
+}
+
+void revarpinput(ac, m)
+struct arpcom *ac;
+struct mbuf *m;
+{
+	IF_ENQUEUE(&kern_revarpq, m);
+}
+
+void raw_input(m, proto, src, dst)
+struct mbuf *m;
+struct sockproto *proto;
+struct sockaddr *src;
+struct sockaddr *dst;
+{
+	kern_rawproto = proto->sp_protocol;
+	IF_ENQUEUE(&kern_rawq, m);
+}
+
+/* ETHERLINK raw sockets. Only attach and detach are done, which put a control
+ * block for the socket's protocol on rawcb and take it off again. */
+#define KERN_NRAWCB 8
+
+static struct rawcb kern_rawcbs[KERN_NRAWCB];
+
+int raw_usrreq(so, req, m, nam, rights)
+struct socket *so;
+int req;
+struct mbuf *m;
+struct mbuf *nam;
+struct mbuf *rights;
+{
+	register struct rawcb *rp;
+
+	switch (req) {
+	case PRU_ATTACH:
+		for (rp = kern_rawcbs; rp < &kern_rawcbs[KERN_NRAWCB] &&
+		     rp->rcb_next; rp++);
+		if (rp == &kern_rawcbs[KERN_NRAWCB]) {
+			return ENOBUFS;
+		}
+		bzero((caddr_t)rp, sizeof(*rp));
+		rp->rcb_socket = so;
+		rp->rcb_proto.sp_family = PF_ETHERLINK;
+		/* the protocol comes in place of nam, as in 4.3BSD */
+		rp->rcb_proto.sp_protocol = (caddr_t)nam - (caddr_t)0;
+		rp->rcb_next = rawcb.rcb_next;
+		rp->rcb_prev = &rawcb;
+		rawcb.rcb_next->rcb_prev = rp;
+		rawcb.rcb_next = rp;
+		so->so_pcb = (caddr_t)rp;
+		return 0;
+	case PRU_DETACH:
+	case PRU_ABORT:
+		if ((rp = sotorawcb(so)) == 0) {
+			return ENOTCONN;
+		}
+		rp->rcb_prev->rcb_next = rp->rcb_next;
+		rp->rcb_next->rcb_prev = rp->rcb_prev;
+		rp->rcb_next = rp->rcb_prev = 0;
+		so->so_pcb = 0;
+		return 0;
+	}
+	return EOPNOTSUPP;
+}
+
+/* Open a raw socket bound to an ethernet type (0 for all), or close it, through
+ * the protocol's pr_usrreq, as socket() and close() would */
+int kern_rawopen(so, type)
+struct socket *so;
+int type;
+{
+	int s, error;
+
+	s = splnet();
+	error = (*ensw[0].pr_usrreq)(so, PRU_ATTACH, (struct mbuf *)0,
+				     (struct mbuf *)((caddr_t)0 + type),
+				     (struct mbuf *)0);
+	splx(s);
+	return error;
+}
+
+int kern_rawclose(so)
+struct socket *so;
+{
+	int s, error;
+
+	s = splnet();
+	error = (*ensw[0].pr_usrreq)(so, PRU_DETACH, (struct mbuf *)0,
+				     (struct mbuf *)0, (struct mbuf *)0);
+	splx(s);
+	return error;
+}
+
+/* Every address resolves to kern_arpmac, except broadcasts */
+int arpresolve(ac, m, destip, desten, usetrailers)
+struct arpcom *ac;
+struct mbuf *m;
+struct in_addr *destip;
+u_char *desten;
+int *usetrailers;
+{
+	register int i;
+
+	for (i = 0; i < 6; i++) {
+		desten[i] = in_broadcast(*destip) ? 0xff : kern_arpmac[i];
+	}
+	*usetrailers = 0;
+	return 1;
+}
+
+void arpwhohas(ac, addr)
+struct arpcom *ac;
+struct in_addr *addr;
+{
+}
+
+void localetheraddr(hint, result)
+u_char *hint;
+u_char *result;
+{
+}
+
+/* The harness's network is class C */
+u_long in_lnaof(in)
+struct in_addr in;
+{
+	return in.s_addr & 0xff;
+}
+
+int in_broadcast(in)
+struct in_addr in;
+{
+	return in.s_addr == INADDR_BROADCAST || (in.s_addr & 0xff) == 0xff;
+}
+
+int looutput(ifp, m, dst)
+struct ifnet *ifp;
+struct mbuf *m;
+struct sockaddr *dst;
+{
+	kern_looutputs++;
+	m_freem(m);
+	return 0;
+}
+
+/* Processes. There is only one, and it is the superuser. */
+int suser()
+{
+	return 1;
+}
+
+int copyin(from, to, len)
+caddr_t from;
+caddr_t to;
+int len;
+{
+	bcopy(from, to, len);
+	return 0;
+}
+
+int copyout(from, to, len)
+caddr_t from;
+caddr_t to;
+int len;
+{
+	bcopy(from, to, len);
+	return 0;
+}
+
+/* Is there a card at *addr? */
+int iocheck(addr)
+caddr_t *addr;
+{
+	return enc_lookup((unsigned char *)*addr) != 0;
+}
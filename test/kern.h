@@ -0,0 +1,43 @@
+/* The kernel that the test harness runs the driver in (see kern.c)
+ *
+ * Copyright 2024, Richard Halkyard
+ */
+
+#ifndef KERN_H
+#define KERN_H
+
+/* mbuf and cluster pools */
+#define KERN_NMBUFS 2048
+#define KERN_NCLUSTERS 512
+
+extern int kern_mbufs;			/* mbufs in use */
+extern int kern_clusters;		/* clusters in use */
+extern int kern_mgets;			/* mbufs allocated so far */
+extern int kern_mclgets;		/* clusters allocated so far */
+extern int kern_mlimit;			/* most mbufs allowed in use */
+
+/* Where the kernel puts what the driver passes up, apart from IP and
+ * AppleTalk frames, which go on ipintrq and etintrq as usual */
+extern struct ifqueue kern_arpq;	/* from arpinput() */
+extern struct ifqueue kern_revarpq;	/* from revarpinput() */
+extern struct ifqueue kern_rawq;	/* from raw_input() */
+extern int kern_rawproto;		/* protocol of last raw_input() */
+extern int kern_looutputs;		/* frames sent to the loopback */
+extern int kern_netisr_et;		/* AppleTalk's netisr number */
+extern unsigned char kern_arpmac[6];	/* what arpresolve() answers */
+
+struct ifnet *kern_config(int nslots, int *slots, int unit);
+int kern_ifaddr(struct ifnet *ifp, unsigned long addr);
+int kern_ioctl(struct ifnet *ifp, int cmd, caddr_t arg);
+int kern_rawopen(struct socket *so, int type);
+int kern_rawclose(struct socket *so);
+void kern_tick(int n);
+int kern_intr(void);
+void kern_drain(struct ifqueue *q);
+struct mbuf *kern_mchain(unsigned char *frame, int len);
+int kern_send(struct ifnet *ifp, struct mbuf *m);
+int kern_output(struct ifnet *ifp, unsigned char *frame, int len);
+int kern_mlen(struct mbuf *m);
+void kern_mcopy(struct mbuf *m, unsigned char *p);
+
+#endif
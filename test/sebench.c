@@ -0,0 +1,451 @@
+/* sebench - replay a packet capture through the driver, and measure it
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: sebench [-a] [-b batch] [-n passes] [file.pcap]
+ *
+ * Feeds the frames in a capture (pcap format, ethernet) to a modelled card and
+ * through the driver's receive path (seint(), se_rpkt(), se_get()), then sends
+ * them through its transmit path (se_output(), se_start(), se_put()), and
+ * reports for each:
+ *
+ *   frames/s	frames handled per second of driver time
+ *   us/frame	driver time per frame
+ *   bytes	bytes copied per frame between mbufs and the card
+ *   regs	register accesses per frame
+ *   mbufs	mbufs allocated per frame, including those for the driver's
+ *		receive reserves
+ *   drops	frames that never got to a protocol (receive), or onto the wire
+ *		(transmit)
+ *
+ * This is done for the whole capture in order, and then again for the frames
+ * of each class (IP, ARP, 802.3 and other, as in sestat) on their own.
+ *
+ * Only the driver's time is counted: interrupt handling and the clock ticks
+ * that follow on receive, and if_output and transmit completion on transmit.
+ * Putting frames into the card and taking them off the protocol queues isn't.
+ * Frames are received and sent batch at a time (-b, 4 by default), with an
+ * interrupt and a clock tick after each batch. The capture is replayed 10 times
+ * (-n) in each run. Without a file, a made-up mix of traffic is used.
+ *
+ * Unicast frames are readdressed to the card before being received, so that
+ * they aren't thrown away by its filter; -a leaves them as they are. Frames
+ * longer than the ethernet maximum are skipped. AppleTalk is taken to be
+ * running, but there are no raw sockets, so the driver drops frames of other
+ * types, and they show up as drops.
+ *
+ * The time is the host's, and so is only good for comparing builds of the
+ * driver with each other. The counts are the same as they would be on a 68k.
+ */
+
+#include <sys/errno.h>
+#include <sys/ioctl.h>
+#include <sys/mbuf.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <net/if.h>
+#include <net/netisr.h>
+#include <net/raw_cb.h>
+#include <netinet/if_ether.h>
+#include <netinet/in.h>
+#include <netinet/ip_var.h>
+
+#include "if_se.h"
+#include "host.h"
+#include "kern.h"
+
+#define SLOT 9
+#define MYIP 0xc0a80101			/* 192.168.1.1 */
+
+#define MAXFRAMES 100000
+#define MAXBATCH 32
+#define MAXFRAME (ETHERMTU + (int)sizeof(struct ether_header))
+
+unsigned char mymac[6] = { 0x00, 0x80, 0x19, 0x12, 0x34, 0x56 };
+
+struct enc_card *card;
+struct ifnet *ifp;
+
+/* The capture */
+unsigned char *frames[MAXFRAMES];
+int framelens[MAXFRAMES];
+int nframes;
+int skipped;
+
+int readdress = 1;
+int batch = 4;
+int passes = 10;
+
+/* What one run measured */
+struct result {
+	int frames;			/* frames offered */
+	int done;			/* frames delivered or sent */
+	double time;			/* driver time, seconds */
+	unsigned long bytes;		/* bytes copied */
+	unsigned long regs;		/* register accesses */
+	unsigned long mbufs;		/* mbufs allocated */
+};
+
+/* Frames sent, by class, counted as they leave the card */
+int txdone[SE_NCLASSES + 1];
+unsigned long txbytes;
+
+/* The class of a frame, or SE_NCLASSES for all of them */
+int frameclass(frame)
+unsigned char *frame;
+{
+	int type = (frame[12] << 8) | frame[13];
+
+	return SE_CLASS(type);
+}
+
+void txhook(c, frame, len)
+struct enc_card *c;
+unsigned char *frame;
+int len;
+{
+	txdone[frameclass(frame)]++;
+	txdone[SE_NCLASSES]++;
+	txbytes += len;
+}
+
+/*
+Reading captures. The file header and each record header are in the byte order
+of the machine that wrote them, which the magic number tells us. There are two
+magic numbers, for microsecond and nanosecond timestamps, but the timestamps
+aren't used.
+*/
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_NSMAGIC 0xa1b23c4d
+#define PCAP_HDRLEN 24
+#define PCAP_RECLEN 16
+#define PCAP_ETHERNET 1
+
+unsigned long getlong(p, swapped)
+unsigned char *p;
+int swapped;
+{
+	if (swapped) {
+		return p[0] | (p[1] << 8) | (p[2] << 16) |
+		       ((unsigned long)p[3] << 24);
+	}
+	return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+int readpcap(name)
+char *name;
+{
+	unsigned char *buf, *p;
+	unsigned long magic;
+	int len, swapped, caplen;
+
+	if ((buf = host_readfile(name, &len)) == 0) {
+		return -1;
+	}
+	if (len < PCAP_HDRLEN) {
+		host_print("%s: not a pcap file\n", name);
+		return -1;
+	}
+	magic = getlong(buf, 0);
+	if (magic == PCAP_MAGIC || magic == PCAP_NSMAGIC) {
+		swapped = 0;
+	} else {
+		magic = getlong(buf, 1);
+		if (magic != PCAP_MAGIC && magic != PCAP_NSMAGIC) {
+			host_print("%s: not a pcap file\n", name);
+			return -1;
+		}
+		swapped = 1;
+	}
+	if (getlong(buf + 20, swapped) != PCAP_ETHERNET) {
+		host_print("%s: not an ethernet capture\n", name);
+		return -1;
+	}
+
+	for (p = buf + PCAP_HDRLEN; p + PCAP_RECLEN <= buf + len;
+	     p += PCAP_RECLEN + caplen) {
+		caplen = getlong(p + 8, swapped);
+		if (caplen < 0 || p + PCAP_RECLEN + caplen > buf + len) {
+			host_print("%s: truncated\n", name);
+			break;
+		}
+		if (caplen < (int)sizeof(struct ether_header) ||
+		    caplen > MAXFRAME || nframes == MAXFRAMES) {
+			skipped++;
+			continue;
+		}
+		frames[nframes] = p + PCAP_RECLEN;
+		framelens[nframes] = caplen;
+		nframes++;
+	}
+	return 0;
+}
+
+/* Without a capture, make up some traffic: mostly IP, in the sizes that
+ * dominate real traffic, with some ARP, AppleTalk and IPv6 */
+unsigned char mixbuf[64 * MAXFRAME];
+
+struct {
+	int type;			/* ethernet type, or 802.3 length */
+	int len;			/* frame length */
+	int count;			/* how many in the mix */
+} mix[] = {
+	{ ETHERTYPE_IP, 60, 16 },	/* TCP acks */
+	{ ETHERTYPE_IP, 590, 4 },
+	{ ETHERTYPE_IP, 1514, 24 },	/* bulk TCP */
+	{ ETHERTYPE_ARP, 60, 4 },
+	{ 0, 100, 6 },			/* 802.3, length filled in */
+	{ 0, 600, 4 },
+	{ 0x86dd, 86, 6 },		/* IPv6 neighbour discovery */
+	{ 0, 0, 0 }
+};
+
+void mkmix()
+{
+	unsigned char *p = mixbuf;
+	int i, j, k, type;
+
+	for (i = 0; mix[i].len; i++) {
+		for (j = 0; j < mix[i].count; j++) {
+			bcopy((caddr_t)mymac, (caddr_t)p, 6);
+			p[6] = 0x02;
+			for (k = 7; k < 12; k++) {
+				p[k] = k + j;
+			}
+			type = mix[i].type ? mix[i].type :
+			       mix[i].len - (int)sizeof(struct ether_header);
+			p[12] = type >> 8;
+			p[13] = type;
+			for (k = 14; k < mix[i].len; k++) {
+				p[k] = k + j;
+			}
+			frames[nframes] = p;
+			framelens[nframes] = mix[i].len;
+			nframes++;
+			p += mix[i].len;
+		}
+	}
+
+	/* Shuffle it, the same way every time */
+	for (i = nframes - 1; i > 0; i--) {
+		j = (i * 7919) % (i + 1);
+		p = frames[i];
+		frames[i] = frames[j];
+		frames[j] = p;
+		k = framelens[i];
+		framelens[i] = framelens[j];
+		framelens[j] = k;
+	}
+}
+
+/* Take what the driver passed up off the protocol queues, counting frames and
+ * the bytes copied to get them there */
+void drain(q, res, hdrlen)
+struct ifqueue *q;
+struct result *res;
+int hdrlen;
+{
+	struct mbuf *m;
+
+	for (;;) {
+		IF_DEQUEUE(q, m);
+		if (m == 0) {
+			break;
+		}
+		res->done++;
+		res->bytes += kern_mlen(m) - sizeof(struct ifnet *) + hdrlen;
+		m_freem(m);
+	}
+}
+
+/* Receive every frame of class cl (all of them if SE_NCLASSES), passes
+ * times */
+void rxrun(cl, res)
+int cl;
+struct result *res;
+{
+	unsigned char buf[MAXFRAME];
+	int pass, i, n, mgets, regs;
+	double t0;
+
+	bzero((caddr_t)res, sizeof(*res));
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < nframes;) {
+			for (n = 0; n < batch && i < nframes; i++) {
+				if (cl != SE_NCLASSES &&
+				    frameclass(frames[i]) != cl) {
+					continue;
+				}
+				bcopy((caddr_t)frames[i], (caddr_t)buf,
+				      framelens[i]);
+				if (readdress && (buf[0] & 1) == 0) {
+					bcopy((caddr_t)mymac, (caddr_t)buf, 6);
+				}
+				enc_rx(card, buf, framelens[i]);
+				res->frames++;
+				n++;
+			}
+			if (n == 0) {
+				break;
+			}
+
+			mgets = kern_mgets;
+			regs = card->nreads + card->nwrites;
+			t0 = host_time();
+			kern_intr();
+			kern_tick(1);
+			res->time += host_time() - t0;
+			res->mbufs += kern_mgets - mgets;
+			res->regs += card->nreads + card->nwrites - regs;
+
+			drain(&ipintrq, res, sizeof(struct ether_header));
+			drain(&kern_arpq, res, sizeof(struct ether_header));
+			drain(&kern_revarpq, res, sizeof(struct ether_header));
+			drain(&etintrq, res, 0);
+			drain(&kern_rawq, res, 0);
+		}
+	}
+}
+
+/* Send every frame of class cl, passes times */
+void txrun(cl, res)
+int cl;
+struct result *res;
+{
+	struct mbuf *chain[MAXBATCH];
+	int pass, i, j, n, mgets, regs, done;
+	double t0;
+
+	bzero((caddr_t)res, sizeof(*res));
+	txbytes = 0;
+	done = txdone[cl];
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < nframes;) {
+			for (n = 0; n < batch && i < nframes; i++) {
+				if (cl != SE_NCLASSES &&
+				    frameclass(frames[i]) != cl) {
+					continue;
+				}
+				chain[n] = kern_mchain(frames[i], framelens[i]);
+				if (chain[n] == 0) {
+					panic("sebench: out of mbufs");
+				}
+				res->frames++;
+				n++;
+			}
+			if (n == 0) {
+				break;
+			}
+
+			mgets = kern_mgets;
+			regs = card->nreads + card->nwrites;
+			t0 = host_time();
+			for (j = 0; j < n; j++) {
+				kern_send(ifp, chain[j]);
+			}
+			kern_intr();
+			res->time += host_time() - t0;
+			res->mbufs += kern_mgets - mgets;
+			res->regs += card->nreads + card->nwrites - regs;
+		}
+	}
+	res->done = txdone[cl] - done;
+	res->bytes = txbytes;
+}
+
+void report(name, res)
+char *name;
+struct result *res;
+{
+	double n = res->frames;
+
+	if (res->frames == 0) {
+		return;
+	}
+	host_print("%-6s %8d %10.0f %8.2f %8.1f %6.1f %6.2f %7d\n", name,
+		   res->frames, res->time > 0 ? n / res->time : 0.0,
+		   res->time * 1e6 / n, res->bytes / n, res->regs / n,
+		   res->mbufs / n, res->frames - res->done);
+}
+
+void heading(what)
+char *what;
+{
+	host_print("\n%s\n%-6s %8s %10s %8s %8s %6s %6s %7s\n", what, "class",
+		   "frames", "frames/s", "us/frame", "bytes", "regs", "mbufs",
+		   "drops");
+}
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	static char *classnames[] = SE_CLASS_NAMES;
+	static int slots[] = { SLOT };
+	struct result res;
+	char *file = 0;
+	int cl, i, usage = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] != '-') {
+			file = argv[i];
+		} else if (argv[i][1] == 'a') {
+			readdress = 0;
+		} else if (argv[i][1] == 'b' && i + 1 < argc) {
+			batch = host_atoi(argv[++i]);
+		} else if (argv[i][1] == 'n' && i + 1 < argc) {
+			passes = host_atoi(argv[++i]);
+		} else {
+			usage = 1;
+		}
+	}
+	if (usage || batch < 1 || batch > MAXBATCH || passes < 1) {
+		host_print("usage: sebench [-a] [-b batch] [-n passes] "
+			   "[file.pcap]\n");
+		host_exit(2);
+	}
+
+	if (file) {
+		if (readpcap(file) < 0) {
+			host_exit(1);
+		}
+	} else {
+		mkmix();
+		file = "(made-up mix)";
+	}
+	host_print("%s: %d frames", file, nframes);
+	if (skipped) {
+		host_print(", %d skipped", skipped);
+	}
+	host_print(", %d passes, batches of %d\n", passes, batch);
+
+	card = enc_attach(SLOT, mymac);
+	card->txhook = txhook;
+	ifp = kern_config(1, slots, 0);
+	if (ifp == 0) {
+		host_print("sebench: card not found\n");
+		host_exit(1);
+	}
+	kern_ifaddr(ifp, MYIP);
+	NETISR_ET = &kern_netisr_et;
+	kern_tick(2);
+
+	heading("receive");
+	rxrun(SE_NCLASSES, &res);
+	report("all", &res);
+	for (cl = 0; cl < SE_NCLASSES; cl++) {
+		rxrun(cl, &res);
+		report(classnames[cl], &res);
+	}
+
+	heading("transmit");
+	txrun(SE_NCLASSES, &res);
+	report("all", &res);
+	for (cl = 0; cl < SE_NCLASSES; cl++) {
+		txrun(cl, &res);
+		report(classnames[cl], &res);
+	}
+	return 0;
+}
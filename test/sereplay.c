@@ -0,0 +1,223 @@
+/* sereplay - play a register access log back into the chip model
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: sereplay [-v] [-c] file
+ *
+ * Reads a log in the form setrace -r prints it (from a driver built with
+ * ENC624J600_REGTRACE), or setest -r prints it from the model, and does each
+ * access again, in order, to a modelled card in the same slot. Writes are
+ * done as they were. Reads are done and the value the model gives is compared
+ * with the one in the log, and the first 20 that differ are shown (-v shows
+ * them all). Then the number of reads, writes and differences for each
+ * register is printed, like the counts setrace prints; -c leaves them out.
+ *
+ * The log doesn't say what happened on the wire or in buffer memory, so reads
+ * that depend on it (the interrupt flags and packet count once frames have
+ * arrived, the receive head pointer, DMA checksums) will differ if the log
+ * covers any traffic. What's left shows where the model and the card part
+ * company, and replaying logs from two versions of the driver shows where
+ * their register traffic does. The card's ethernet address is taken from the
+ * first reads of MAADR1-3 in the log, so that they match.
+ *
+ * Exits 1 if any read differed, and 2 if the log couldn't be read.
+ */
+
+#include "enc624j600_registers.h"
+#include "host.h"
+
+#define NSHOW 20
+#define NREGS 0x200
+
+/* One access */
+struct access {
+	int slot;
+	int write;
+	int reg;
+	int value;
+	int line;
+};
+
+#define MAXACCESSES 200000
+
+struct access trace[MAXACCESSES];
+int naccesses;
+
+int reads[NREGS], writes[NREGS], differ[NREGS];
+
+/* Parse a hex number, returning a pointer past it, or 0 if there isn't one */
+char *gethex(p, vp)
+char *p;
+int *vp;
+{
+	int v = 0, d, n = 0;
+
+	while (*p == ' ') {
+		p++;
+	}
+	for (;; p++, n++) {
+		if (*p >= '0' && *p <= '9') {
+			d = *p - '0';
+		} else if (*p >= 'a' && *p <= 'f') {
+			d = *p - 'a' + 10;
+		} else if (*p >= 'A' && *p <= 'F') {
+			d = *p - 'A' + 10;
+		} else {
+			break;
+		}
+		v = (v << 4) | d;
+	}
+	*vp = v;
+	return n ? p : 0;
+}
+
+/* Parse the log into trace[]. Lines that don't look like accesses (such as
+ * setrace's "earlier accesses lost" message) are skipped, and the table of
+ * counts at the end is ignored. Returns -1 if the log can't be read. */
+int readlog(name)
+char *name;
+{
+	char *buf, *p, *end, *next;
+	struct access *a;
+	int len, line, rw;
+
+	if ((buf = (char *)host_readfile(name, &len)) == 0) {
+		return -1;
+	}
+	end = buf + len;
+	for (p = buf, line = 1; p < end; p = next, line++) {
+		for (next = p; next < end && *next != '\n'; next++);
+		if (next < end) {
+			*next++ = 0;
+		}
+		if (*p == 0) {
+			/* The counts follow a blank line */
+			break;
+		}
+		if (naccesses == MAXACCESSES) {
+			host_print("%s: too many accesses\n", name);
+			return -1;
+		}
+		a = &trace[naccesses];
+		if ((p = gethex(p, &a->slot)) == 0 || *p++ != ' ') {
+			continue;
+		}
+		rw = *p++;
+		if ((rw != 'R' && rw != 'W') ||
+		    (p = gethex(p, &a->reg)) == 0 ||
+		    (p = gethex(p, &a->value)) == 0) {
+			continue;
+		}
+		a->write = rw == 'W';
+
+		/* Only writes can go to the set-bit and clear-bit registers */
+		if (a->slot > 15 || a->reg < 0x7e00 || (a->reg & 1) ||
+		    a->reg >= 0x7e00 + (a->write ? NREGS : NREGS / 2) ||
+		    a->value > 0xffff) {
+			host_print("%s:%d: bad access\n", name, line);
+			return -1;
+		}
+		a->line = line;
+		naccesses++;
+	}
+	return 0;
+}
+
+/* Put a card in each slot the log uses, with the address it read */
+void attach()
+{
+	unsigned char mac[16][6];
+	int seen[16], got[16];
+	struct access *a;
+	int i, j, part;
+
+	for (i = 0; i < 16; i++) {
+		seen[i] = got[i] = 0;
+		for (j = 0; j < 6; j++) {
+			mac[i][j] = 0;
+		}
+	}
+	for (a = trace; a < trace + naccesses; a++) {
+		seen[a->slot] = 1;
+		part = a->reg == MAADR1 ? 0 : a->reg == MAADR2 ? 1 :
+		       a->reg == MAADR3 ? 2 : -1;
+		if (part >= 0 && !a->write && !(got[a->slot] & (1 << part))) {
+			mac[a->slot][2 * part] = a->value >> 8;
+			mac[a->slot][2 * part + 1] = a->value;
+			got[a->slot] |= 1 << part;
+		}
+	}
+	for (i = 0; i < 16; i++) {
+		if (seen[i]) {
+			enc_attach(i, mac[i]);
+		}
+	}
+}
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	struct access *a;
+	int verbose = 0, counts = 1, ndiffer = 0, r;
+	unsigned short value;
+
+	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+		if (argv[1][1] == 'v') {
+			verbose = 1;
+		} else if (argv[1][1] == 'c') {
+			counts = 0;
+		} else {
+			argc = 0;
+			break;
+		}
+	}
+	if (argc != 2) {
+		host_print("usage: sereplay [-v] [-c] file\n");
+		host_exit(2);
+	}
+	if (readlog(argv[1]) < 0) {
+		host_exit(2);
+	}
+	attach();
+
+	for (a = trace; a < trace + naccesses; a++) {
+		r = a->reg - 0x7e00;
+		if (a->write) {
+			enc_write(enc_base(a->slot), a->reg,
+				  enc_busval(a->reg, a->value));
+			writes[r]++;
+			continue;
+		}
+		value = enc_read(enc_base(a->slot), a->reg);
+		value = enc_busval(a->reg, value);
+		reads[r]++;
+		if (value != a->value) {
+			if (verbose || ndiffer < NSHOW) {
+				host_print("%d: %x R %04x %-10s log %04x, model "
+					   "%04x\n", a->line, a->slot, a->reg,
+					   enc_regname(a->reg), a->value,
+					   value);
+			} else if (ndiffer == NSHOW) {
+				host_print("(more differences not shown)\n");
+			}
+			differ[r]++;
+			ndiffer++;
+		}
+	}
+
+	if (counts) {
+		host_print("\n%-12s %8s %8s %8s\n", "register", "reads",
+			   "writes", "differ");
+		for (r = 0; r < NREGS; r++) {
+			if (reads[r] || writes[r]) {
+				host_print("%-12s %8d %8d %8d\n",
+					   enc_regname(r + 0x7e00), reads[r],
+					   writes[r], differ[r]);
+			}
+		}
+	}
+	host_print("sereplay: %d accesses, %d reads differed\n", naccesses,
+		   ndiffer);
+	return ndiffer ? 1 : 0;
+}
@@ -0,0 +1,1078 @@
+/* setest - run the driver against the chip model, and check what comes out
+ *
+ * Copyright 2024, Richard Halkyard
+ *
+ * usage: setest [-v] [-r]
+ *
+ * Attaches modelled cards in slots 9 and B (and probes an empty slot A), brings
+ * the first one's interface up, and then feeds frames in at the wire end and
+ * checks what the driver passes up, and sends frames and checks what the card
+ * puts on the wire. The second card only comes into it when bonded. -v shows
+ * the driver's console messages, and -r its register accesses, in the form
+ * setrace -r prints them. Exits nonzero if any check fails.
+ */
+
+#include <sys/errno.h>
+#include <sys/ioctl.h>
+#include <sys/mbuf.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <net/if.h>
+#include <net/netisr.h>
+#include <net/raw_cb.h>
+#include <netinet/if_ether.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_var.h>
+
+#include "if_se.h"
+#include "host.h"
+#include "kern.h"
+
+#define SLOT 9
+#define MYIP 0xc0a80101			/* 192.168.1.1 */
+#define PEERIP 0xc0a80102		/* 192.168.1.2 */
+
+unsigned char mymac[6] = { 0x00, 0x80, 0x19, 0x12, 0x34, 0x56 };
+unsigned char peermac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+unsigned char othermac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+unsigned char mac2[6] = { 0x00, 0x80, 0x19, 0x12, 0x34, 0x57 };
+unsigned char bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+unsigned char atmcast[6] = { 0x09, 0x00, 0x07, 0xff, 0xff, 0xff };
+
+struct enc_card *card, *card2;
+struct ifnet *ifp, *ifp2;
+int failures;
+char *testname;
+
+/* Frames the card has sent */
+#define NTXFRAMES 64
+unsigned char txframe[NTXFRAMES][ETHERMTU + 14];
+int txlen[NTXFRAMES];
+int ntx;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			check_failed(__LINE__, #cond); \
+			return; \
+		} \
+	} while (0)
+
+void check_failed(line, cond)
+int line;
+char *cond;
+{
+	host_print("FAIL %s: line %d: %s\n", testname, line, cond);
+	failures++;
+}
+
+void txhook(c, frame, len)
+struct enc_card *c;
+unsigned char *frame;
+int len;
+{
+	if (ntx < NTXFRAMES) {
+		bcopy((caddr_t)frame, (caddr_t)txframe[ntx], len);
+		txlen[ntx] = len;
+	}
+	ntx++;
+}
+
+/* Make a frame with a payload that can be checked by checkdata() */
+int mkframe(buf, dst, type, len, seq)
+unsigned char *buf;
+unsigned char *dst;
+int type;
+int len;
+int seq;
+{
+	int i;
+
+	bcopy((caddr_t)dst, (caddr_t)buf, 6);
+	bcopy((caddr_t)peermac, (caddr_t)buf + 6, 6);
+	buf[12] = type >> 8;
+	buf[13] = type;
+	for (i = 14; i < len; i++) {
+		buf[i] = (i + seq * 7) & 0xff;
+	}
+	return len;
+}
+
+/* Does p hold len bytes of the payload of frame seq, starting at offset? */
+int checkdata(p, len, offset, seq)
+unsigned char *p;
+int len;
+int offset;
+int seq;
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (p[i] != ((i + offset + seq * 7) & 0xff)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Take a packet off a protocol queue, and copy its data out */
+int dequeue(q, buf)
+struct ifqueue *q;
+unsigned char *buf;
+{
+	struct mbuf *m;
+	int len;
+
+	IF_DEQUEUE(q, m);
+	if (m == 0) {
+		return -1;
+	}
+	len = kern_mlen(m);
+	kern_mcopy(m, buf);
+	m_freem(m);
+	return len;
+}
+
+int getstats(st)
+struct se_stats *st;
+{
+	struct ifreq ifr;
+
+	ifr.ifr_data = (caddr_t)st;
+	return kern_ioctl(ifp, SIOCGSESTATS, (caddr_t)&ifr);
+}
+
+int setparam(param, value)
+int param;
+int value;
+{
+	struct ifreq ifr;
+	struct se_param sp;
+
+	sp.sp_param = param;
+	sp.sp_value = value;
+	ifr.ifr_data = (caddr_t)&sp;
+	return kern_ioctl(ifp, SIOCSSEPARAM, (caddr_t)&ifr);
+}
+
+int getparam(param, valuep)
+int param;
+int *valuep;
+{
+	struct ifreq ifr;
+	struct se_param sp;
+	int error;
+
+	sp.sp_param = param;
+	ifr.ifr_data = (caddr_t)&sp;
+	error = kern_ioctl(ifp, SIOCGSEPARAM, (caddr_t)&ifr);
+	*valuep = sp.sp_value;
+	return error;
+}
+
+/* The Internet checksum of len bytes, as a number */
+int cksum(p, len, sum)
+unsigned char *p;
+int len;
+unsigned long sum;
+{
+	int i;
+
+	for (i = 0; i + 1 < len; i += 2) {
+		sum += (p[i] << 8) | p[i + 1];
+	}
+	if (len & 1) {
+		sum += p[len - 1] << 8;
+	}
+	while (sum >> 16) {
+		sum = (sum >> 16) + (sum & 0xffff);
+	}
+	return sum;
+}
+
+/*
+The tests
+*/
+
+/* The cards in slots 9 and B were found and attached, and the empty slot
+ * wasn't, and bringing the interface up read the address from the card */
+void test_attach()
+{
+	struct arpcom *ac = (struct arpcom *)ifp;
+	struct ifnet *i;
+	int n = 0;
+
+	CHECK(ifp != 0 && ifp2 != 0);
+	for (i = ifnet; i; i = i->if_next) {
+		n++;
+	}
+	CHECK(n == 2);
+	CHECK(!(ifp2->if_flags & IFF_RUNNING));
+	CHECK(ifp->if_flags & IFF_RUNNING);
+	CHECK(bcmp((caddr_t)ac->ac_enaddr, (caddr_t)mymac, 6) == 0);
+	CHECK(enc_peek(card, ECON1) & ECON1_RXEN);
+	CHECK(enc_peek(card, EIE) & EIE_INTIE);
+}
+
+/* An IP frame to us goes on ipintrq, ethernet header stripped, interface
+ * pointer in front */
+void test_rxip()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	int len;
+
+	netisr = 0;
+	len = mkframe(frame, mymac, ETHERTYPE_IP, 100, 1);
+	CHECK(enc_rx(card, frame, len));
+	CHECK(kern_intr() == 1);
+	CHECK(netisr & (1 << NETISR_IP));
+	len = dequeue(&ipintrq, buf);
+	CHECK(len == sizeof(ifp) + 100 - 14);
+	CHECK(*(struct ifnet **)buf == ifp);
+	CHECK(checkdata(buf + sizeof(ifp), 100 - 14, 14, 1));
+	CHECK(ipintrq.ifq_len == 0);
+	CHECK((enc_peek(card, ESTAT) & ESTAT_PKTCNT_MASK) == 0);
+	CHECK(!enc_irq(card));
+}
+
+/* A full-size frame comes up whole, in a cluster */
+void test_rxbig()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	struct mbuf *m;
+	int len;
+
+	len = mkframe(frame, mymac, ETHERTYPE_IP, ETHERMTU + 14, 2);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	m = ipintrq.ifq_head;
+	CHECK(m != 0);
+	CHECK(m->m_next == 0 || kern_mlen(m) > MCLBYTES);
+	len = dequeue(&ipintrq, buf);
+	CHECK(len == sizeof(ifp) + ETHERMTU);
+	CHECK(checkdata(buf + sizeof(ifp), ETHERMTU, 14, 2));
+}
+
+/* A broadcast ARP goes to arpinput() */
+void test_rxarp()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	int len;
+
+	len = mkframe(frame, bcast, ETHERTYPE_ARP, 60, 3);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	len = dequeue(&kern_arpq, buf);
+	CHECK(len == sizeof(ifp) + 60 - 14);
+	CHECK(checkdata(buf + sizeof(ifp), 60 - 14, 14, 3));
+}
+
+/* The chip drops unicasts to someone else; the driver drops types that nobody
+ * wants, without copying them, until a raw socket asks for them, and again once
+ * it has been closed */
+void test_rxunwanted()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	unsigned char other[6];
+	struct se_stats st0, st1;
+	struct socket so;
+	int len, gets;
+
+	bcopy((caddr_t)mymac, (caddr_t)other, 6);
+	other[5]++;
+	len = mkframe(frame, other, ETHERTYPE_IP, 100, 4);
+	CHECK(!enc_rx(card, frame, len));
+
+	CHECK(getstats(&st0) == 0);
+	gets = kern_mgets;
+	len = mkframe(frame, mymac, 0x9000, 100, 4);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_unwanted == st0.ss_unwanted + 1);
+	CHECK(st1.ss_class[SE_CLASS_OTHER].cs_idrops ==
+	      st0.ss_class[SE_CLASS_OTHER].cs_idrops + 1);
+	CHECK(kern_mgets == gets);
+	CHECK(kern_rawq.ifq_len == 0);
+
+	/* Now with a socket for it */
+	CHECK(kern_rawopen(&so, 0x9000) == 0);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(kern_rawproto == 0x9000);
+	CHECK(dequeue(&kern_rawq, buf) == 100 - 14);
+	CHECK(checkdata(buf, 100 - 14, 14, 4));
+
+	/* and after it's closed */
+	CHECK(kern_rawclose(&so) == 0);
+	CHECK(getstats(&st0) == 0);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_unwanted == st0.ss_unwanted + 1);
+	CHECK(kern_rawq.ifq_len == 0);
+
+	/* A socket for every type takes anything */
+	CHECK(kern_rawopen(&so, 0) == 0);
+	len = mkframe(frame, mymac, 0x9123, 100, 5);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(kern_rawproto == 0x9123);
+	CHECK(dequeue(&kern_rawq, buf) == 100 - 14);
+	CHECK(checkdata(buf, 100 - 14, 14, 5));
+	CHECK(kern_rawclose(&so) == 0);
+}
+
+/* 802.3 frames go to AppleTalk, header and all, with any padding cut off,
+ * once it is running, and are dropped before that */
+void test_rx8023()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	int len;
+
+	len = mkframe(frame, mymac, 20, 60, 5);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(etintrq.ifq_len == 0);
+
+	NETISR_ET = &kern_netisr_et;
+	netisr = 0;
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(netisr & (1 << kern_netisr_et));
+	len = dequeue(&etintrq, buf);
+	CHECK(len == sizeof(ifp) + 14 + 20);
+	CHECK(*(struct ifnet **)buf == ifp);
+	CHECK(bcmp((caddr_t)buf + sizeof(ifp), (caddr_t)frame, 14) == 0);
+	CHECK(checkdata(buf + sizeof(ifp) + 14, 20, 14, 5));
+
+	len = mkframe(frame, mymac, 600, 614, 6);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	len = dequeue(&etintrq, buf);
+	CHECK(len == sizeof(ifp) + 614);
+	CHECK(checkdata(buf + sizeof(ifp) + 14, 600, 14, 6));
+}
+
+/* Multicasts get through once subscribed to, and not after unsubscribing */
+void test_rxmulti()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	struct sockaddr sa;
+	int len;
+
+	len = mkframe(frame, atmcast, 100, 114, 7);
+	CHECK(!enc_rx(card, frame, len));
+
+	bzero((caddr_t)&sa, sizeof(sa));
+	bcopy((caddr_t)atmcast, sa.sa_data, 6);
+	CHECK(kern_ioctl(ifp, SIOCSMAR, (caddr_t)&sa) == 0);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	len = dequeue(&etintrq, buf);
+	CHECK(len == sizeof(ifp) + 114);
+	CHECK(checkdata(buf + sizeof(ifp) + 14, 100, 14, 7));
+
+	CHECK(kern_ioctl(ifp, SIOCUMAR, (caddr_t)&sa) == 0);
+	CHECK(kern_ioctl(ifp, SIOCUMAR, (caddr_t)&sa) == EADDRNOTAVAIL);
+	len = mkframe(frame, atmcast, 100, 114, 7);
+	CHECK(!enc_rx(card, frame, len));
+}
+
+/* The pattern match filter: in SE_PM_BCAST mode, broadcasts only get in if
+ * they match, and nothing else that matches gets in that wouldn't have anyway;
+ * in SE_PM_NOTUCAST, the same goes for multicasts */
+void test_pmatch()
+{
+	unsigned char frame[ETHERMTU + 14], other[6];
+	struct se_pmatch pm;
+	struct ifreq ifr;
+	int len;
+
+	bcopy((caddr_t)mymac, (caddr_t)other, 6);
+	other[5]++;
+	bzero((caddr_t)&pm, sizeof(pm));
+	pm.pm_mode = SE_PM_BCAST;
+	pm.pm_offset = 0;
+	pm.pm_mask[1] = 0x30;
+	pm.pm_pattern[12] = ETHERTYPE_ARP >> 8;
+	pm.pm_pattern[13] = ETHERTYPE_ARP & 0xff;
+	ifr.ifr_data = (caddr_t)&pm;
+	CHECK(kern_ioctl(ifp, SIOCSSEPMATCH, (caddr_t)&ifr) == 0);
+
+	len = mkframe(frame, bcast, ETHERTYPE_ARP, 60, 1);
+	CHECK(enc_rx(card, frame, len));
+	len = mkframe(frame, bcast, ETHERTYPE_IP, 60, 2);
+	CHECK(!enc_rx(card, frame, len));
+	len = mkframe(frame, other, ETHERTYPE_ARP, 60, 3);
+	CHECK(!enc_rx(card, frame, len));
+	len = mkframe(frame, mymac, ETHERTYPE_IP, 60, 4);
+	CHECK(enc_rx(card, frame, len));
+
+	pm.pm_mode = SE_PM_NOTUCAST;
+	CHECK(kern_ioctl(ifp, SIOCSSEPMATCH, (caddr_t)&ifr) == 0);
+	len = mkframe(frame, atmcast, ETHERTYPE_ARP, 60, 5);
+	CHECK(enc_rx(card, frame, len));
+	len = mkframe(frame, atmcast, ETHERTYPE_IP, 60, 6);
+	CHECK(!enc_rx(card, frame, len));
+	len = mkframe(frame, bcast, ETHERTYPE_IP, 60, 7);
+	CHECK(!enc_rx(card, frame, len));
+	len = mkframe(frame, mymac, ETHERTYPE_IP, 60, 8);
+	CHECK(enc_rx(card, frame, len));
+
+	pm.pm_mode = SE_PM_OFF;
+	CHECK(kern_ioctl(ifp, SIOCSSEPMATCH, (caddr_t)&ifr) == 0);
+	len = mkframe(frame, bcast, ETHERTYPE_IP, 60, 9);
+	CHECK(enc_rx(card, frame, len));
+
+	kern_intr();
+	kern_drain(&kern_arpq);
+	kern_drain(&ipintrq);
+	kern_drain(&kern_rawq);
+}
+
+/* With a capture filter, frames for other hosts that it accepts go up whole to
+ * a socket for SE_CAPTURE_TYPE, cut to the length it gives, and the ones it
+ * rejects are dropped */
+void test_capture()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	struct se_filter filt;
+	struct se_stats st0, st1;
+	struct socket so;
+	struct ifreq ifr;
+	int len;
+
+	/* Take the first 64 bytes of frames of type 0x9000 */
+	bzero((caddr_t)&filt, sizeof(filt));
+	filt.sf_len = 4;
+	filt.sf_snaplen = ETHERMTU + 14;
+	filt.sf_prog[0].fi_code = SE_F_LDH;
+	filt.sf_prog[0].fi_k = 12;
+	filt.sf_prog[1].fi_code = SE_F_JEQ;
+	filt.sf_prog[1].fi_k = 0x9000;
+	filt.sf_prog[1].fi_jf = 1;
+	filt.sf_prog[2].fi_code = SE_F_RET;
+	filt.sf_prog[2].fi_k = 64;
+	filt.sf_prog[3].fi_code = SE_F_RET;
+	ifr.ifr_data = (caddr_t)&filt;
+	CHECK(kern_ioctl(ifp, SIOCSSEFILTER, (caddr_t)&ifr) == 0);
+	CHECK(kern_rawopen(&so, SE_CAPTURE_TYPE) == 0);
+	CHECK(getstats(&st0) == 0);
+
+	len = mkframe(frame, othermac, 0x9000, 200, 6);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(kern_rawproto == SE_CAPTURE_TYPE);
+	CHECK(dequeue(&kern_rawq, buf) == 64);
+	CHECK(bcmp((caddr_t)buf, (caddr_t)frame, 14) == 0);
+	CHECK(checkdata(buf + 14, 64 - 14, 14, 6));
+
+	len = mkframe(frame, othermac, 0x9001, 200, 7);
+	CHECK(enc_rx(card, frame, len));
+	kern_intr();
+	CHECK(kern_rawq.ifq_len == 0);
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_captured == st0.ss_captured + 1);
+	CHECK(st1.ss_capbytes == st0.ss_capbytes + 64);
+
+	CHECK(kern_rawclose(&so) == 0);
+	filt.sf_len = 0;
+	CHECK(kern_ioctl(ifp, SIOCSSEFILTER, (caddr_t)&ifr) == 0);
+
+	/* and without the filter, the card doesn't take frames for others */
+	len = mkframe(frame, othermac, 0x9000, 200, 8);
+	CHECK(!enc_rx(card, frame, len));
+}
+
+/* Frames of every size, enough to go round the ring many times, all come up
+ * intact and in order */
+void test_rxring()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	int seq, len, flen, burst, i;
+
+	for (seq = 0; seq < 600; seq += burst) {
+		burst = 1 + seq % 5;
+		for (i = 0; i < burst; i++) {
+			flen = 60 + ((seq + i) * 37) % (ETHERMTU + 14 - 59);
+			mkframe(frame, mymac, ETHERTYPE_IP, flen, seq + i);
+			CHECK(enc_rx(card, frame, flen));
+		}
+		kern_intr();
+		for (i = 0; i < burst; i++) {
+			flen = 60 + ((seq + i) * 37) % (ETHERMTU + 14 - 59);
+			len = dequeue(&ipintrq, buf);
+			CHECK(len == (int)sizeof(ifp) + flen - 14);
+			CHECK(checkdata(buf + sizeof(ifp), flen - 14, 14,
+					seq + i));
+		}
+		CHECK(ipintrq.ifq_len == 0);
+	}
+	CHECK(kern_mbufs <= 2 * (SE_RXPOOL + 1));
+}
+
+/* When the ring fills up, the chip drops frames, and the driver counts them
+ * and carries on with the ones that got in */
+void test_rxoverflow()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	struct se_stats st0, st1;
+	int n, len;
+
+	CHECK(getstats(&st0) == 0);
+	for (n = 0; n < 100; n++) {
+		mkframe(frame, mymac, ETHERTYPE_IP, 1000, n);
+		if (!enc_rx(card, frame, 1000)) {
+			break;
+		}
+	}
+	CHECK(n > 0 && n < 100);
+	kern_intr();
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_rxabort == st0.ss_rxabort + 1);
+	CHECK(st1.ss_ipackets == st0.ss_ipackets + n);
+	while (n-- > 0) {
+		len = dequeue(&ipintrq, buf);
+		CHECK(len == sizeof(ifp) + 1000 - 14);
+	}
+	mkframe(frame, mymac, ETHERTYPE_IP, 1000, 0);
+	CHECK(enc_rx(card, frame, 1000));
+	kern_intr();
+	CHECK(dequeue(&ipintrq, buf) == sizeof(ifp) + 1000 - 14);
+}
+
+/* Spoil the header of the frame off bytes on from the read pointer (which is
+ * just past ERXTAIL), by pointing its next-packet pointer at an odd address,
+ * outside the ring */
+void rxspoil(off)
+int off;
+{
+	int p, start = SWAPBYTES(enc_peek(card, ERXST));
+
+	p = SWAPBYTES(enc_peek(card, ERXTAIL)) + 2 + off;
+	while (p >= ENC_MEMSIZE) {
+		p -= ENC_MEMSIZE - start;
+	}
+	card->mem[p] = 0x01;
+	card->mem[p + 1] = 0x01;
+}
+
+/* If a frame's header in the ring is garbage, the driver finds the next good
+ * frame, and carries on from there, losing just the bad one. If it would have
+ * to look too far, it resets the ring instead. */
+void test_rxresync()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	struct se_stats st0, st1;
+	int n;
+
+	CHECK(getstats(&st0) == 0);
+	for (n = 0; n < 3; n++) {
+		mkframe(frame, mymac, ETHERTYPE_IP, 300, n);
+		CHECK(enc_rx(card, frame, 300));
+	}
+
+	rxspoil(0);
+
+	/* The pass that resyncs stops there, and leaves the rest to be polled
+	 * for */
+	kern_intr();
+	kern_tick(1);
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_rxresyncs == st0.ss_rxresyncs + 1);
+	CHECK(st1.ss_resyncdrops == st0.ss_resyncdrops + 1);
+	CHECK(st1.ss_rxresets == st0.ss_rxresets);
+	for (n = 1; n < 3; n++) {
+		CHECK(dequeue(&ipintrq, buf) == (int)sizeof(ifp) + 300 - 14);
+		CHECK(checkdata(buf + sizeof(ifp), 300 - 14, 14, n));
+	}
+	CHECK(ipintrq.ifq_len == 0);
+	CHECK((enc_peek(card, ESTAT) & ESTAT_PKTCNT_MASK) == 0);
+
+	/* and the ring is still good after */
+	mkframe(frame, mymac, ETHERTYPE_IP, 300, 3);
+	CHECK(enc_rx(card, frame, 300));
+	kern_intr();
+	CHECK(dequeue(&ipintrq, buf) == (int)sizeof(ifp) + 300 - 14);
+	CHECK(checkdata(buf + sizeof(ifp), 300 - 14, 14, 3));
+
+	/* Two full-size frames spoilt is more than it will step over */
+	for (n = 0; n < 3; n++) {
+		mkframe(frame, mymac, ETHERTYPE_IP, ETHERMTU + 14, n);
+		CHECK(enc_rx(card, frame, ETHERMTU + 14));
+	}
+	rxspoil(0);
+	rxspoil(8 + ETHERMTU + 14 + 4);
+	CHECK(getstats(&st0) == 0);
+	kern_intr();
+	kern_tick(1);
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_rxresyncs == st0.ss_rxresyncs);
+	CHECK(st1.ss_rxresets == st0.ss_rxresets + 1);
+	CHECK(ipintrq.ifq_len == 0);
+	CHECK((enc_peek(card, ESTAT) & ESTAT_PKTCNT_MASK) == 0);
+	mkframe(frame, mymac, ETHERTYPE_IP, 300, 4);
+	CHECK(enc_rx(card, frame, 300));
+	kern_intr();
+	CHECK(dequeue(&ipintrq, buf) == (int)sizeof(ifp) + 300 - 14);
+	CHECK(checkdata(buf + sizeof(ifp), 300 - 14, 14, 4));
+}
+
+/* With a receive budget, the ISR takes that many frames and leaves the rest to
+ * be polled for on the following ticks */
+void test_rxbudget()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	int n;
+
+	CHECK(setparam(SE_PARAM_RXBUDGET, 4) == 0);
+	for (n = 0; n < 10; n++) {
+		mkframe(frame, mymac, ETHERTYPE_IP, 200, n);
+		CHECK(enc_rx(card, frame, 200));
+	}
+	kern_intr();
+	CHECK(ipintrq.ifq_len == 4);
+	CHECK(!(enc_peek(card, EIE) & EIE_PKTIE));
+	kern_tick(1);
+	CHECK(ipintrq.ifq_len == 8);
+	kern_tick(2);
+	CHECK(ipintrq.ifq_len == 10);
+	CHECK(enc_peek(card, EIE) & EIE_PKTIE);
+	for (n = 0; n < 10; n++) {
+		CHECK(dequeue(&ipintrq, buf) == sizeof(ifp) + 200 - 14);
+		CHECK(checkdata(buf + sizeof(ifp), 200 - 14, 14, n));
+	}
+	CHECK(setparam(SE_PARAM_RXBUDGET, SE_RXBUDGET) == 0);
+}
+
+/* Deferred receive is off until asked for. When on, the interrupt handler
+ * leaves frames in the ring for the next tick's poll. */
+void test_softrx()
+{
+	unsigned char frame[ETHERMTU + 14], buf[ETHERMTU + 14];
+	int n, value;
+
+	CHECK(getparam(SE_PARAM_SOFTRX, &value) == 0 && value == 0);
+	CHECK(setparam(SE_PARAM_SOFTRX, 1) == 0);
+	for (n = 0; n < 3; n++) {
+		mkframe(frame, mymac, ETHERTYPE_IP, 100, n);
+		CHECK(enc_rx(card, frame, 100));
+	}
+	kern_intr();
+	CHECK(ipintrq.ifq_len == 0);
+	CHECK(!(enc_peek(card, EIE) & EIE_PKTIE));
+	kern_tick(1);
+	CHECK(ipintrq.ifq_len == 3);
+	CHECK(enc_peek(card, EIE) & EIE_PKTIE);
+	for (n = 0; n < 3; n++) {
+		CHECK(dequeue(&ipintrq, buf) == sizeof(ifp) + 100 - 14);
+		CHECK(checkdata(buf + sizeof(ifp), 100 - 14, 14, n));
+	}
+	CHECK(setparam(SE_PARAM_SOFTRX, 0) == 0);
+}
+
+/* A raw frame goes out as it was given, with our source address */
+void test_txraw()
+{
+	unsigned char frame[ETHERMTU + 14];
+	struct se_stats st0, st1;
+	int len;
+
+	CHECK(getstats(&st0) == 0);
+	ntx = 0;
+	len = mkframe(frame, peermac, 0x9000, 300, 8);
+	CHECK(kern_output(ifp, frame, len) == 0);
+	kern_intr();
+	CHECK(ntx == 1);
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_class[SE_CLASS_OTHER].cs_opackets ==
+	      st0.ss_class[SE_CLASS_OTHER].cs_opackets + 1);
+	CHECK(txlen[0] == len);
+	CHECK(bcmp((caddr_t)txframe[0], (caddr_t)peermac, 6) == 0);
+	CHECK(bcmp((caddr_t)txframe[0] + 6, (caddr_t)mymac, 6) == 0);
+	CHECK(txframe[0][12] == 0x90 && txframe[0][13] == 0x00);
+	CHECK(checkdata(txframe[0] + 14, len - 14, 14, 8));
+	CHECK(kern_mbufs <= 2 * (SE_RXPOOL + 1));
+}
+
+/* An IP packet gets an ethernet header made for it, with the address ARP
+ * gives and the IP type in network order. UDP packets come from port
+ * 1024 + seq (mod 256), so that different seqs are different flows. */
+int sendip(len, proto, seq)
+int len;
+int proto;
+int seq;
+{
+	struct mbuf *m;
+	struct sockaddr_in sin;
+	struct ip *ip;
+	unsigned char *p;
+	int i;
+
+	m = m_get(M_DONTWAIT, MT_DATA);
+	mclget(m);
+	m->m_len = len;
+	p = mtod(m, unsigned char *);
+	for (i = 0; i < len; i++) {
+		p[i] = (i + 14 + seq * 7) & 0xff;
+	}
+	ip = (struct ip *)p;
+	bzero((caddr_t)ip, sizeof(*ip));
+	ip->ip_v = 4;
+	ip->ip_hl = 5;
+	ip->ip_len = len;
+	ip->ip_ttl = 64;
+	ip->ip_p = proto;
+	ip->ip_src.s_addr = MYIP;
+	ip->ip_dst.s_addr = PEERIP;
+	if (proto == IPPROTO_UDP) {
+		p[20] = 0x04;
+		p[21] = seq;
+		p[22] = 0x00;
+		p[23] = 0x35;
+		p[24] = (len - 20) >> 8;
+		p[25] = len - 20;
+		p[26] = 0;
+		p[27] = 0;
+	}
+
+	bzero((caddr_t)&sin, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = PEERIP;
+	return (*ifp->if_output)(ifp, m, (struct sockaddr *)&sin);
+}
+
+void test_txip()
+{
+	struct se_stats st0, st1;
+	int len = 500;
+
+	CHECK(getstats(&st0) == 0);
+	ntx = 0;
+	CHECK(sendip(len, 250, 9) == 0);
+	kern_intr();
+	CHECK(ntx == 1);
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_class[SE_CLASS_IP].cs_opackets ==
+	      st0.ss_class[SE_CLASS_IP].cs_opackets + 1);
+	CHECK(st1.ss_class[SE_CLASS_IP].cs_obytes ==
+	      st0.ss_class[SE_CLASS_IP].cs_obytes + 14 + len);
+	CHECK(txlen[0] == 14 + len);
+	CHECK(bcmp((caddr_t)txframe[0], (caddr_t)kern_arpmac, 6) == 0);
+	CHECK(bcmp((caddr_t)txframe[0] + 6, (caddr_t)mymac, 6) == 0);
+	CHECK(txframe[0][12] == 0x08 && txframe[0][13] == 0x00);
+	CHECK(txframe[0][14] == 0x45);
+	CHECK(checkdata(txframe[0] + 14 + 20, len - 20, 20 + 14, 9));
+}
+
+/* With checksum offload, zeroed IP and UDP checksums are filled in, and come
+ * out right */
+void test_txcsum()
+{
+	unsigned char *p;
+	int len = 777, sum;
+
+	CHECK(setparam(SE_PARAM_TXCSUM, 1) == 0);
+	ntx = 0;
+	CHECK(sendip(len, IPPROTO_UDP, 10) == 0);
+	kern_intr();
+	CHECK(setparam(SE_PARAM_TXCSUM, 0) == 0);
+	CHECK(ntx == 1);
+	p = txframe[0] + 14;
+	CHECK(p[10] != 0 || p[11] != 0);
+	CHECK(cksum(p, 20, 0) == 0xffff);
+
+	/* UDP, with the pseudo-header */
+	CHECK(p[26] != 0 || p[27] != 0);
+	sum = cksum(p + 12, 8, 0) + IPPROTO_UDP + len - 20;
+	CHECK(cksum(p + 20, len - 20, sum) == 0xffff);
+}
+
+/* A burst of frames all goes out, in order, through every transmit slot */
+void test_txburst()
+{
+	unsigned char frame[ETHERMTU + 14];
+	int n, len;
+
+	ntx = 0;
+	for (n = 0; n < 20; n++) {
+		len = mkframe(frame, peermac, 0x9000, 60 + n * 70, n);
+		CHECK(kern_output(ifp, frame, len) == 0);
+		if (n % 3 == 2) {
+			kern_intr();
+		}
+	}
+	kern_intr();
+	CHECK(ntx == 20);
+	for (n = 0; n < 20; n++) {
+		CHECK(txlen[n] == 60 + n * 70);
+		CHECK(checkdata(txframe[n] + 14, txlen[n] - 14, 14, n));
+	}
+}
+
+/* If the transmitter gets stuck, the frames staged are written off, and the
+ * ring starts again from slot 0 */
+void test_txstuck()
+{
+	unsigned char frame[ETHERMTU + 14];
+	struct se_stats st0, st1;
+	int n, len;
+
+	CHECK(getstats(&st0) == 0);
+	ntx = 0;
+	card->txstall = 1;
+	for (n = 0; n < 2; n++) {
+		len = mkframe(frame, peermac, 0x9000, 100, n);
+		CHECK(kern_output(ifp, frame, len) == 0);
+	}
+	kern_intr();
+	CHECK(ntx == 0);
+	CHECK(enc_peek(card, ECON1) & ECON1_TXRTS);
+
+	/* Changing the slot count drains the ring first */
+	CHECK(setparam(SE_PARAM_TXSLOTS, 2) == 0);
+	CHECK(!(enc_peek(card, ECON1) & ECON1_TXRTS));
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_oerrors == st0.ss_oerrors + 2);
+
+	card->txstall = 0;
+	len = mkframe(frame, peermac, 0x9000, 200, 11);
+	CHECK(kern_output(ifp, frame, len) == 0);
+	kern_intr();
+	CHECK(ntx == 1);
+	CHECK(enc_peek(card, ETXST) == SWAPBYTES(SE_TXSLOT(0)));
+	CHECK(txlen[0] == 200);
+	CHECK(checkdata(txframe[0] + 14, 200 - 14, 14, 11));
+	CHECK(setparam(SE_PARAM_TXSLOTS, SE_TXSLOTS) == 0);
+}
+
+/* In lazy transmit mode, a burst still goes out back to back, and only the
+ * last frame's completion is left to be reaped */
+void test_txlazy()
+{
+	unsigned char frame[ETHERMTU + 14];
+	struct se_stats st0, st1;
+	int n, len;
+
+	CHECK(setparam(SE_PARAM_TXLAZY, 1) == 0);
+	CHECK(getstats(&st0) == 0);
+	ntx = 0;
+
+	/* Hold up the first frame, so the rest pile up behind it */
+	card->txstall = 1;
+	for (n = 0; n < 6; n++) {
+		len = mkframe(frame, peermac, 0x9000, 100, n);
+		CHECK(kern_output(ifp, frame, len) == 0);
+	}
+	CHECK(ntx == 0);
+	CHECK(enc_peek(card, EIE) & EIE_TXIE);
+	card->txstall = 0;
+	enc_txfinish(card);
+	kern_intr();
+	CHECK(ntx == 6);
+	for (n = 0; n < 6; n++) {
+		CHECK(checkdata(txframe[n] + 14, 100 - 14, 14, n));
+	}
+	CHECK(!(enc_peek(card, EIE) & EIE_TXIE));
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_txintrs == st0.ss_txintrs + 5);
+
+	kern_tick(1);
+	CHECK(getstats(&st1) == 0);
+	CHECK(st1.ss_txreaped == st0.ss_txreaped + 1);
+	CHECK(setparam(SE_PARAM_TXLAZY, 0) == 0);
+	CHECK(enc_peek(card, EIE) & EIE_TXIE);
+}
+
+/* A link change gets the MAC set up for the new duplex */
+void test_link()
+{
+	enc_setlink(card, 1, 0);
+	kern_intr();
+	kern_tick(2);
+	CHECK(!(enc_peek(card, MACON2) & MACON2_FULDPX));
+	enc_setlink(card, 1, 1);
+	kern_intr();
+	kern_tick(2);
+	CHECK(enc_peek(card, MACON2) & MACON2_FULDPX);
+}
+
+/* SIOCZSESTATS hands back the counts and zeroes the driver's own (but not the
+ * interface's), and SIOCZSETRACE empties the trace ring */
+void test_zerostats()
+{
+	unsigned char frame[ETHERMTU + 14];
+	struct se_stats st;
+	struct se_trace tr;
+	struct ifreq ifr;
+	unsigned long n;
+
+	CHECK(setparam(SE_PARAM_TRACE, 1) == 0);
+	mkframe(frame, mymac, ETHERTYPE_IP, 100, 1);
+	CHECK(enc_rx(card, frame, 100));
+	CHECK(kern_intr() == 1);
+	kern_drain(&ipintrq);
+	CHECK(setparam(SE_PARAM_TRACE, 0) == 0);
+	ifr.ifr_data = (caddr_t)&st;
+	CHECK(kern_ioctl(ifp, SIOCZSESTATS, (caddr_t)&ifr) == 0);
+	CHECK(st.ss_ibytes != 0 && st.ss_class[SE_CLASS_IP].cs_ipackets != 0);
+	n = st.ss_ipackets;
+	CHECK(getstats(&st) == 0);
+	CHECK(st.ss_ibytes == 0 && st.ss_class[SE_CLASS_IP].cs_ipackets == 0);
+	CHECK(st.ss_ipackets == n);
+	ifr.ifr_data = (caddr_t)&tr;
+	CHECK(kern_ioctl(ifp, SIOCZSETRACE, (caddr_t)&ifr) == 0);
+	CHECK(tr.st_next != 0);
+	CHECK(kern_ioctl(ifp, SIOCGSETRACE, (caddr_t)&ifr) == 0);
+	CHECK(tr.st_next == 0);
+}
+
+/* Bonded to the second card, flows go out over both. When the second card's
+ * link drops, what was waiting to go out on it goes out on the first. */
+void test_bond()
+{
+	struct se_bond bond;
+	struct ifreq ifr;
+	int n, sent;
+
+	ifr.ifr_data = (caddr_t)&bond;
+	bond.sb_members = 1 << ifp2->if_unit;
+	CHECK(kern_ioctl(ifp, SIOCSSEBOND, (caddr_t)&ifr) == 0);
+	kern_tick(2);
+	CHECK(kern_ioctl(ifp, SIOCGSEBOND, (caddr_t)&ifr) == 0);
+	CHECK(bond.sb_active == (1 << ifp->if_unit | 1 << ifp2->if_unit));
+
+	ntx = 0;
+	card2->ntx = 0;
+	for (n = 0; n < 8; n++) {
+		CHECK(sendip(100, IPPROTO_UDP, n) == 0);
+	}
+	kern_intr();
+	CHECK(ntx > 0 && card2->ntx > 0 && ntx + card2->ntx == 8);
+	CHECK(bcmp((caddr_t)txframe[0] + 6, (caddr_t)mymac, 6) == 0);
+
+	/* Until the driver has finished with the link change, the second
+	 * card's flows wait on its send queue */
+	enc_setlink(card2, 0, 0);
+	kern_intr();
+	ntx = 0;
+	card2->ntx = 0;
+	for (n = 0; n < 8; n++) {
+		CHECK(sendip(100, IPPROTO_UDP, n) == 0);
+	}
+	kern_intr();
+	sent = ntx;
+	CHECK(sent < 8 && ifp2->if_snd.ifq_len == 8 - sent);
+	kern_tick(2);
+	kern_intr();
+	CHECK(ifp2->if_snd.ifq_len == 0);
+	CHECK(ntx == 8 && card2->ntx == 0);
+	CHECK(kern_ioctl(ifp, SIOCGSEBOND, (caddr_t)&ifr) == 0);
+	CHECK(bond.sb_active == 1 << ifp->if_unit);
+
+	enc_setlink(card2, 1, 1);
+	kern_intr();
+	kern_tick(2);
+	bond.sb_members = 0;
+	CHECK(kern_ioctl(ifp, SIOCSSEBOND, (caddr_t)&ifr) == 0);
+	CHECK(!(ifp2->if_flags & IFF_RUNNING));
+
+	/* Leaving before the new member's link poll has run cancels it, and
+	 * joining again starts another */
+	bond.sb_members = 1 << ifp2->if_unit;
+	CHECK(kern_ioctl(ifp, SIOCSSEBOND, (caddr_t)&ifr) == 0);
+	bond.sb_members = 0;
+	CHECK(kern_ioctl(ifp, SIOCSSEBOND, (caddr_t)&ifr) == 0);
+	kern_tick(2);
+	CHECK(kern_ioctl(ifp2, SIOCGSEBOND, (caddr_t)&ifr) == 0);
+	CHECK(bond.sb_active == 0);
+	bond.sb_members = 1 << ifp2->if_unit;
+	CHECK(kern_ioctl(ifp, SIOCSSEBOND, (caddr_t)&ifr) == 0);
+	kern_tick(2);
+	CHECK(kern_ioctl(ifp, SIOCGSEBOND, (caddr_t)&ifr) == 0);
+	CHECK(bond.sb_active == (1 << ifp->if_unit | 1 << ifp2->if_unit));
+	bond.sb_members = 0;
+	CHECK(kern_ioctl(ifp, SIOCSSEBOND, (caddr_t)&ifr) == 0);
+}
+
+struct test {
+	char *name;
+	void (*func)();
+} tests[] = {
+	{ "attach", test_attach },
+	{ "rxip", test_rxip },
+	{ "rxbig", test_rxbig },
+	{ "rxarp", test_rxarp },
+	{ "rxunwanted", test_rxunwanted },
+	{ "rx8023", test_rx8023 },
+	{ "rxmulti", test_rxmulti },
+	{ "pmatch", test_pmatch },
+	{ "capture", test_capture },
+	{ "rxring", test_rxring },
+	{ "rxoverflow", test_rxoverflow },
+	{ "rxresync", test_rxresync },
+	{ "rxbudget", test_rxbudget },
+	{ "softrx", test_softrx },
+	{ "txraw", test_txraw },
+	{ "txip", test_txip },
+	{ "txcsum", test_txcsum },
+	{ "txburst", test_txburst },
+	{ "txstuck", test_txstuck },
+	{ "txlazy", test_txlazy },
+	{ "link", test_link },
+	{ "bond", test_bond },
+	{ "zerostats", test_zerostats },
+	{ 0, 0 }
+};
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	static int slots[] = { SLOT, SLOT + 1, SLOT + 2 };
+	struct test *t;
+	int before;
+
+	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+		if (argv[1][1] == 'v') {
+			host_verbose = 1;
+		} else if (argv[1][1] == 'r') {
+			enc_log = 1;
+		}
+	}
+
+	card = enc_attach(SLOT, mymac);
+	card->txhook = txhook;
+	card2 = enc_attach(SLOT + 2, mac2);
+	ifp = kern_config(3, slots, 0);
+	if (ifp == 0) {
+		host_print("setest: card not found\n");
+		host_exit(1);
+	}
+	for (ifp2 = ifnet; ifp2 && ifp2->if_unit != 2; ifp2 = ifp2->if_next);
+	kern_ifaddr(ifp, MYIP);
+	kern_tick(2);
+
+	for (t = tests; t->name; t++) {
+		testname = t->name;
+		before = failures;
+		(*t->func)();
+		kern_drain(&ipintrq);
+		kern_drain(&etintrq);
+		kern_drain(&kern_arpq);
+		kern_drain(&kern_rawq);
+		if (failures == before) {
+			host_print("ok %s\n", t->name);
+		}
+	}
+	if (failures) {
+		host_print("setest: %d test(s) failed\n", failures);
+		host_exit(1);
+	}
+	host_print("setest: all tests passed\n");
+	return 0;
+}